@@ -107,6 +107,7 @@ __declspec(dllexport) int LibInitialize(void) {
 // Perform one-time plugin un-initialization in this method."
 // The system doesn't pay attention to a return value.
 __declspec(dllexport) int LibShutdown(void) {
+  ReleaseBoneScanner();
   Gdiplus::GdiplusShutdown(gdiplusToken);
   return TRUE;
 }
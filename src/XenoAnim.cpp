@@ -0,0 +1,295 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "XenoAnim.h"
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || _M_IX86_FP >= 2
+#define XENO_SSE
+#include <emmintrin.h>
+#endif
+
+XenoSampleGrid XenoBuildSampleGrid(const std::vector<float> &frameTimes,
+                                   float sampleTime, int numSamples) {
+  // Frames landing this close to source sample take it as is
+  const float snapThreshold = 1e-4f;
+  const int numFrames = static_cast<int>(frameTimes.size());
+  const int lastSample = numSamples - 1;
+  XenoSampleGrid grid;
+  grid.segments.resize(numFrames);
+  grid.nextSegments.resize(numFrames);
+  grid.weights.resize(numFrames);
+
+  for (int f = 0; f < numFrames; f++) {
+    const float position =
+        sampleTime > 0.f ? frameTimes[f] / sampleTime : 0.f;
+    int segment = static_cast<int>(position);
+    float weight = position - segment;
+
+    if (weight > 1.f - snapThreshold) {
+      segment++;
+      weight = 0.f;
+    } else if (weight < snapThreshold)
+      weight = 0.f;
+
+    if (segment >= lastSample) {
+      segment = lastSample;
+      weight = 0.f;
+    } else if (segment < 0) {
+      segment = 0;
+      weight = 0.f;
+    }
+
+    grid.segments[f] = segment;
+    grid.nextSegments[f] = weight > 0.f ? segment + 1 : segment;
+    grid.weights[f] = weight;
+  }
+
+  return grid;
+}
+
+void XenoResampleLinear(const float *in, const XenoSampleGrid &grid,
+                        float *out) {
+  const int numFrames = static_cast<int>(grid.segments.size());
+  const int *segments = grid.segments.data();
+  const int *nexts = grid.nextSegments.data();
+  const float *weights = grid.weights.data();
+  int f = 0;
+
+#ifdef XENO_SSE
+  for (; f + 4 <= numFrames; f += 4) {
+    const int *s = segments + f;
+    const int *n = nexts + f;
+    const __m128 a = _mm_setr_ps(in[s[0]], in[s[1]], in[s[2]], in[s[3]]);
+    const __m128 b = _mm_setr_ps(in[n[0]], in[n[1]], in[n[2]], in[n[3]]);
+    const __m128 w = _mm_loadu_ps(weights + f);
+    _mm_storeu_ps(out + f, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), w)));
+  }
+#endif
+
+  for (; f < numFrames; f++) {
+    const float a = in[segments[f]];
+    const float b = in[nexts[f]];
+    out[f] = a + (b - a) * weights[f];
+  }
+}
+
+void XenoResampleRotation(const float *const in[4],
+                          const XenoSampleGrid &grid, float *const out[4]) {
+  const int numFrames = static_cast<int>(grid.segments.size());
+  const int *segments = grid.segments.data();
+  const int *nexts = grid.nextSegments.data();
+  const float *weights = grid.weights.data();
+  int f = 0;
+
+#ifdef XENO_SSE
+  const __m128 signMask = _mm_set1_ps(-0.f);
+  const __m128 zero = _mm_setzero_ps();
+
+  for (; f + 4 <= numFrames; f += 4) {
+    const int *s = segments + f;
+    const int *n = nexts + f;
+    __m128 a[4], b[4];
+
+    for (int c = 0; c < 4; c++) {
+      const float *comp = in[c];
+      a[c] = _mm_setr_ps(comp[s[0]], comp[s[1]], comp[s[2]], comp[s[3]]);
+      b[c] = _mm_setr_ps(comp[n[0]], comp[n[1]], comp[n[2]], comp[n[3]]);
+    }
+
+    const __m128 dot = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(a[0], b[0]), _mm_mul_ps(a[1], b[1])),
+        _mm_add_ps(_mm_mul_ps(a[2], b[2]), _mm_mul_ps(a[3], b[3])));
+    // Flip right side into same hemisphere
+    const __m128 flip = _mm_and_ps(dot, signMask);
+    const __m128 w = _mm_loadu_ps(weights + f);
+    const __m128 exact = _mm_cmpeq_ps(w, zero);
+    __m128 r[4];
+
+    for (int c = 0; c < 4; c++)
+      r[c] = _mm_add_ps(
+          a[c], _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(b[c], flip), a[c]), w));
+
+    const __m128 length = _mm_sqrt_ps(_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(r[0], r[0]), _mm_mul_ps(r[1], r[1])),
+        _mm_add_ps(_mm_mul_ps(r[2], r[2]), _mm_mul_ps(r[3], r[3]))));
+
+    for (int c = 0; c < 4; c++) {
+      const __m128 normalized = _mm_div_ps(r[c], length);
+      _mm_storeu_ps(out[c] + f,
+                    _mm_or_ps(_mm_and_ps(exact, a[c]),
+                              _mm_andnot_ps(exact, normalized)));
+    }
+  }
+#endif
+
+  for (; f < numFrames; f++) {
+    const int s = segments[f];
+    const int n = nexts[f];
+    const float w = weights[f];
+    float a[4], b[4];
+
+    for (int c = 0; c < 4; c++) {
+      a[c] = in[c][s];
+      b[c] = in[c][n];
+    }
+
+    if (w == 0.f) {
+      for (int c = 0; c < 4; c++)
+        out[c][f] = a[c];
+
+      continue;
+    }
+
+    const float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+    const float sign = std::signbit(dot) ? -1.f : 1.f;
+    float r[4];
+
+    for (int c = 0; c < 4; c++)
+      r[c] = a[c] + (b[c] * sign - a[c]) * w;
+
+    const float length =
+        sqrtf(r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + r[3] * r[3]);
+
+    for (int c = 0; c < 4; c++)
+      out[c][f] = r[c] / length;
+  }
+}
+
+// Douglas-Peucker over frames, error(a, b, f) is deviation of frame f from
+// interpolation between keys a and b.
+template <class Error>
+static void ReduceKeys(int numFrames, float tolerance, const Error &error,
+                       std::vector<int> &keys) {
+  keys.clear();
+
+  if (numFrames < 1)
+    return;
+
+  bool isStatic = true;
+
+  for (int f = 1; f < numFrames && isStatic; f++)
+    isStatic = error(0, 0, f) <= tolerance;
+
+  if (isStatic) {
+    keys.push_back(0);
+    return;
+  }
+
+  const int lastFrame = numFrames - 1;
+  std::vector<char> used(numFrames);
+  std::vector<std::pair<int, int>> spans{{0, lastFrame}};
+  used[0] = used[lastFrame] = 1;
+
+  while (!spans.empty()) {
+    const std::pair<int, int> span = spans.back();
+    spans.pop_back();
+
+    float maxError = tolerance;
+    int splitFrame = -1;
+
+    for (int f = span.first + 1; f < span.second; f++) {
+      const float cError = error(span.first, span.second, f);
+
+      if (cError > maxError) {
+        maxError = cError;
+        splitFrame = f;
+      }
+    }
+
+    if (splitFrame < 0)
+      continue;
+
+    used[splitFrame] = 1;
+    spans.emplace_back(span.first, splitFrame);
+    spans.emplace_back(splitFrame, span.second);
+  }
+
+  for (int f = 0; f < numFrames; f++)
+    if (used[f])
+      keys.push_back(f);
+}
+
+void XenoReduceLinear(const float *const in[], int numComponents,
+                      int numFrames, float tolerance, std::vector<int> &keys) {
+  ReduceKeys(
+      numFrames, tolerance,
+      [&](int a, int b, int f) {
+        const float t =
+            b > a ? static_cast<float>(f - a) / static_cast<float>(b - a)
+                  : 0.f;
+        float error = 0.f;
+
+        for (int c = 0; c < numComponents; c++) {
+          const float *comp = in[c];
+          const float delta = comp[a] + (comp[b] - comp[a]) * t - comp[f];
+          error += delta * delta;
+        }
+
+        return std::sqrt(error);
+      },
+      keys);
+}
+
+static double QuatDot(const float *const in[4], int a, int b) {
+  return static_cast<double>(in[0][a]) * in[0][b] +
+         static_cast<double>(in[1][a]) * in[1][b] +
+         static_cast<double>(in[2][a]) * in[2][b] +
+         static_cast<double>(in[3][a]) * in[3][b];
+}
+
+// Angles are in double, tolerances of fraction of degree are
+// under float precision of acos near 1.
+void XenoReduceRotation(const float *const in[4], int numFrames,
+                        float tolerance, std::vector<int> &keys) {
+  ReduceKeys(
+      numFrames, tolerance,
+      [&](int a, int b, int f) {
+        const double t =
+            b > a ? static_cast<double>(f - a) / static_cast<double>(b - a)
+                  : 0.0;
+        double cosTheta = QuatDot(in, a, b);
+        const double sign = cosTheta < 0.0 ? -1.0 : 1.0;
+        cosTheta = std::fabs(cosTheta);
+
+        double wa = 1.0 - t, wb = t;
+
+        if (cosTheta < 0.9999) {
+          const double theta = std::acos(cosTheta);
+          const double sinTheta = std::sin(theta);
+          wa = std::sin(wa * theta) / sinTheta;
+          wb = std::sin(wb * theta) / sinTheta;
+        }
+
+        wb *= sign;
+        double interp[4], length = 0.0, dot = 0.0;
+
+        for (int c = 0; c < 4; c++) {
+          interp[c] = in[c][a] * wa + in[c][b] * wb;
+          length += interp[c] * interp[c];
+        }
+
+        for (int c = 0; c < 4; c++)
+          dot += interp[c] * in[c][f];
+
+        dot = std::fabs(dot) / std::sqrt(length);
+
+        return static_cast<float>(2.0 * std::acos(dot < 1.0 ? dot : 1.0));
+      },
+      keys);
+}
@@ -0,0 +1,53 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Whole track animation sampling kernels, structure of arrays.
+
+#pragma once
+#include <vector>
+
+// Sampling of output frame grid from evenly spaced source samples.
+// Segments are found once, then shared by every track and component.
+struct XenoSampleGrid {
+  std::vector<int> segments;     // left source sample per frame
+  std::vector<int> nextSegments; // right source sample per frame
+  std::vector<float> weights;    // blend towards right sample
+};
+
+XenoSampleGrid XenoBuildSampleGrid(const std::vector<float> &frameTimes,
+                                   float sampleTime, int numSamples);
+
+// Linear interpolation of single component track.
+void XenoResampleLinear(const float *in, const XenoSampleGrid &grid,
+                        float *out);
+
+// Normalized linear interpolation of quaternion track along shortest path,
+// in and out are x, y, z, w component arrays.
+void XenoResampleRotation(const float *const in[4],
+                          const XenoSampleGrid &grid, float *const out[4]);
+
+// Error bounded key reduction, keys receive frames, that have to be keyed,
+// so linear interpolation between them stays within tolerance everywhere.
+// Constant channel collapses into single key at frame 0.
+// in is array of numComponents component arrays, error is euclidean.
+void XenoReduceLinear(const float *const in[], int numComponents,
+                      int numFrames, float tolerance, std::vector<int> &keys);
+
+// Same for quaternion track with spherical interpolation, tolerance is
+// rotation angle in radians.
+void XenoReduceRotation(const float *const in[4], int numFrames,
+                        float tolerance, std::vector<int> &keys);
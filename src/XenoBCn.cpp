@@ -0,0 +1,211 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "XenoBCn.h"
+#include "XenoBCnRow.h"
+#include "XenoCPU.h"
+#include "XenoThreads.h"
+#include <cmath>
+
+int XenoBCBlockSize(XenoBCFormat format) {
+  return format == XenoBC1 || format == XenoBC4 ? 8 : 16;
+}
+
+static uint32_t PackRGBA(int r, int g, int b, int a) {
+  return static_cast<uint32_t>(r) | (static_cast<uint32_t>(g) << 8) |
+         (static_cast<uint32_t>(b) << 16) | (static_cast<uint32_t>(a) << 24);
+}
+
+// BC2 and BC3 always interpolate 4 colors.
+static void ColorPalette(const uchar *block, bool fourColors,
+                         uint32_t palette[4]) {
+  const int c0 = block[0] | (block[1] << 8);
+  const int c1 = block[2] | (block[3] << 8);
+  int rgb[2][3];
+
+  for (int c = 0; c < 2; c++) {
+    const int color = c ? c1 : c0;
+    const int r = (color >> 11) & 0x1f;
+    const int g = (color >> 5) & 0x3f;
+    const int b = color & 0x1f;
+    rgb[c][0] = (r << 3) | (r >> 2);
+    rgb[c][1] = (g << 2) | (g >> 4);
+    rgb[c][2] = (b << 3) | (b >> 2);
+  }
+
+  const int(&a)[3] = rgb[0];
+  const int(&b)[3] = rgb[1];
+  palette[0] = PackRGBA(a[0], a[1], a[2], 255);
+  palette[1] = PackRGBA(b[0], b[1], b[2], 255);
+
+  if (fourColors || c0 > c1) {
+    palette[2] = PackRGBA((2 * a[0] + b[0]) / 3, (2 * a[1] + b[1]) / 3,
+                          (2 * a[2] + b[2]) / 3, 255);
+    palette[3] = PackRGBA((a[0] + 2 * b[0]) / 3, (a[1] + 2 * b[1]) / 3,
+                          (a[2] + 2 * b[2]) / 3, 255);
+  } else {
+    palette[2] = PackRGBA((a[0] + b[0]) / 2, (a[1] + b[1]) / 2,
+                          (a[2] + b[2]) / 2, 255);
+    palette[3] = 0;
+  }
+}
+
+// BC3 alpha, BC4 and BC5 channel.
+static void ChannelPalette(const uchar *block, uchar palette[8]) {
+  const int a0 = block[0];
+  const int a1 = block[1];
+  palette[0] = static_cast<uchar>(a0);
+  palette[1] = static_cast<uchar>(a1);
+
+  if (a0 > a1) {
+    for (int i = 1; i < 7; i++)
+      palette[i + 1] = static_cast<uchar>(((7 - i) * a0 + i * a1) / 7);
+  } else {
+    for (int i = 1; i < 5; i++)
+      palette[i + 1] = static_cast<uchar>(((5 - i) * a0 + i * a1) / 5);
+
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+// Z of unit normal from RG in [0, 255] mapped to [-1, 1]. Every step is
+// exact or single IEEE rounding, so vector path gives same results.
+static int ReconstructZ(int r, int g) {
+  const int x = 2 * r - 255;
+  const int y = 2 * g - 255;
+  int d = 255 * 255 - x * x - y * y;
+
+  if (d < 0)
+    d = 0;
+
+  const float z = std::sqrt(static_cast<float>(d));
+
+  return static_cast<int>((z + 255.f) * 0.5f + 0.5f);
+}
+
+static void DecodeBlockScalar(XenoBCFormat format, const uchar *block,
+                              uint32_t *out, size_t pitch,
+                              bool reconstructZ) {
+  uint32_t texels[16];
+
+  switch (format) {
+  case XenoBC1:
+  case XenoBC2:
+  case XenoBC3: {
+    const uchar *colorBlock = format == XenoBC1 ? block : block + 8;
+    uint32_t palette[4];
+    ColorPalette(colorBlock, format != XenoBC1, palette);
+    const uint32_t indices = ReadU32(colorBlock + 4);
+
+    for (int t = 0; t < 16; t++)
+      texels[t] = palette[(indices >> (2 * t)) & 3];
+
+    if (format == XenoBC2) {
+      const uint64_t alphas = ReadU64(block);
+
+      for (int t = 0; t < 16; t++)
+        texels[t] = (texels[t] & 0xffffff) |
+                    (static_cast<uint32_t>((alphas >> (4 * t)) & 0xf) * 17
+                     << 24);
+    } else if (format == XenoBC3) {
+      uchar alphaPalette[8];
+      ChannelPalette(block, alphaPalette);
+      const uint64_t indices = ReadU64(block) >> 16;
+
+      for (int t = 0; t < 16; t++)
+        texels[t] = (texels[t] & 0xffffff) |
+                    (static_cast<uint32_t>(
+                         alphaPalette[(indices >> (3 * t)) & 7])
+                     << 24);
+    }
+    break;
+  }
+  case XenoBC4: {
+    uchar palette[8];
+    ChannelPalette(block, palette);
+    const uint64_t indices = ReadU64(block) >> 16;
+
+    for (int t = 0; t < 16; t++) {
+      const int value = palette[(indices >> (3 * t)) & 7];
+      texels[t] = PackRGBA(value, value, value, 255);
+    }
+    break;
+  }
+  case XenoBC5: {
+    uchar redPalette[8], greenPalette[8];
+    ChannelPalette(block, redPalette);
+    ChannelPalette(block + 8, greenPalette);
+    const uint64_t redIndices = ReadU64(block) >> 16;
+    const uint64_t greenIndices = ReadU64(block + 8) >> 16;
+
+    for (int t = 0; t < 16; t++) {
+      const int r = redPalette[(redIndices >> (3 * t)) & 7];
+      const int g = greenPalette[(greenIndices >> (3 * t)) & 7];
+      texels[t] = PackRGBA(r, g, reconstructZ ? ReconstructZ(r, g) : 0, 255);
+    }
+    break;
+  }
+  }
+
+  for (int r = 0; r < 4; r++)
+    memcpy(out + r * pitch, texels + r * 4, 16);
+}
+
+void XenoDecodeBCRowScalar(XenoBCFormat format, const uchar *blocks,
+                           int width, int numRows, uchar *out, size_t stride,
+                           bool reconstructZ) {
+  DecodeRow(format, blocks, width, numRows, out, stride,
+            [&](const uchar *block, uint32_t *texels, size_t pitch) {
+              DecodeBlockScalar(format, block, texels, pitch, reconstructZ);
+            });
+}
+
+void XenoDecodeBCRow(XenoBCFormat format, const uchar *blocks, int width,
+                     int numRows, uchar *out, size_t stride,
+                     bool reconstructZ) {
+  static const bool useSSSE3 = XenoCPUHasSSSE3();
+
+  if (useSSSE3)
+    XenoDecodeBCRowSSSE3(format, blocks, width, numRows, out, stride,
+                         reconstructZ);
+  else
+    XenoDecodeBCRowScalar(format, blocks, width, numRows, out, stride,
+                          reconstructZ);
+}
+
+void XenoDecodeBC(XenoBCFormat format, const void *data, int width,
+                  int height, uchar *out, bool reconstructZ,
+                  XenoThreadPool *pool) {
+  const uchar *blocks = static_cast<const uchar *>(data);
+  const size_t rowSize =
+      static_cast<size_t>((width + 3) / 4) * XenoBCBlockSize(format);
+  const size_t stride = static_cast<size_t>(width) * 4;
+  const int numBlockRows = (height + 3) / 4;
+
+  auto decodeRow = [&](int r) {
+    const int numRows = height - r * 4 < 4 ? height - r * 4 : 4;
+    XenoDecodeBCRow(format, blocks + rowSize * r, width, numRows,
+                    out + stride * r * 4, stride, reconstructZ);
+  };
+
+  if (pool)
+    XenoParallelFor(*pool, numBlockRows, decodeRow);
+  else
+    for (int r = 0; r < numBlockRows; r++)
+      decodeRow(r);
+}
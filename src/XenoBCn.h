@@ -0,0 +1,54 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// BC1-BC5 block decoders into RGBA8.
+
+#pragma once
+#include "MXMD.h"
+#include <cstddef>
+
+class XenoThreadPool;
+
+enum XenoBCFormat {
+  XenoBC1,
+  XenoBC2,
+  XenoBC3,
+  XenoBC4, // replicated into RGB
+  XenoBC5, // RG, B is 0 or reconstructed normal Z
+};
+
+int XenoBCBlockSize(XenoBCFormat format);
+
+// Decodes single row of blocks into numRows (1 - 4) rows of width pixels,
+// stride is in bytes. Vectorized when CPU supports SSSE3.
+void XenoDecodeBCRow(XenoBCFormat format, const uchar *blocks, int width,
+                     int numRows, uchar *out, size_t stride,
+                     bool reconstructZ);
+// SSSE3 decoder, caller checks CPU support. Scalar on non x86 builds.
+void XenoDecodeBCRowSSSE3(XenoBCFormat format, const uchar *blocks, int width,
+                          int numRows, uchar *out, size_t stride,
+                          bool reconstructZ);
+// Plain per pixel decoder, reference for XenoDecodeBCRow.
+void XenoDecodeBCRowScalar(XenoBCFormat format, const uchar *blocks,
+                           int width, int numRows, uchar *out, size_t stride,
+                           bool reconstructZ);
+
+// Decodes whole image into tightly packed RGBA8, rows of blocks are decoded
+// in parallel. Without pool, image is decoded on calling thread.
+void XenoDecodeBC(XenoBCFormat format, const void *data, int width,
+                  int height, uchar *out, bool reconstructZ,
+                  XenoThreadPool *pool);
@@ -0,0 +1,61 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Block row walk shared by scalar and SSSE3 BCn decoders.
+
+#pragma once
+#include "XenoBCn.h"
+#include <cstdint>
+#include <cstring>
+
+static inline uint32_t ReadU32(const uchar *data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static inline uint64_t ReadU64(const uchar *data) {
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+template <class F>
+static void DecodeRow(XenoBCFormat format, const uchar *blocks, int width,
+                      int numRows, uchar *out, size_t stride,
+                      const F &decodeBlock) {
+  const int blockSize = XenoBCBlockSize(format);
+  const int numBlocks = (width + 3) / 4;
+  const size_t pitch = stride / 4;
+  uint32_t *texels = reinterpret_cast<uint32_t *>(out);
+
+  for (int b = 0; b < numBlocks; b++, blocks += blockSize) {
+    const int numColumns = width - b * 4 < 4 ? width - b * 4 : 4;
+
+    if (numColumns == 4 && numRows == 4) {
+      decodeBlock(blocks, texels + b * 4, pitch);
+      continue;
+    }
+
+    // Edge block goes through tile, then clipped
+    uint32_t tile[16];
+    decodeBlock(blocks, tile, 4);
+
+    for (int r = 0; r < numRows; r++)
+      memcpy(texels + r * pitch + b * 4, tile + r * 4, numColumns * 4);
+  }
+}
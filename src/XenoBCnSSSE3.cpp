@@ -0,0 +1,284 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Built with SSSE3 enabled, only called when CPU reports it.
+
+#include "XenoBCn.h"
+#include "XenoBCnRow.h"
+
+#if defined(__SSSE3__) || defined(_M_X64) || defined(_M_IX86)
+#define XENO_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#ifdef XENO_SSSE3
+namespace {
+// Byte shuffles, that expand packed block indices into texels.
+struct ShuffleTables {
+  __m128i colorRows[256]; // 4x 2 bit index -> 4 texels of color palette
+  uint32_t channelIndices[4096]; // 4x 3 bit index -> 4 bytes
+  __m128i channelRows[4]; // block row of channel values -> 32 bit lanes
+  __m128i grayRows[4];    // block row of channel values -> RGB of texels
+
+  ShuffleTables() {
+    for (int i = 0; i < 256; i++) {
+      alignas(16) uchar control[16];
+
+      for (int t = 0; t < 4; t++)
+        for (int c = 0; c < 4; c++)
+          control[t * 4 + c] =
+              static_cast<uchar>(((i >> (2 * t)) & 3) * 4 + c);
+
+      colorRows[i] = _mm_load_si128(reinterpret_cast<__m128i *>(control));
+    }
+
+    for (int i = 0; i < 4096; i++) {
+      uint32_t bytes = 0;
+
+      for (int t = 0; t < 4; t++)
+        bytes |= ((i >> (3 * t)) & 7) << (8 * t);
+
+      channelIndices[i] = bytes;
+    }
+
+    for (int r = 0; r < 4; r++) {
+      alignas(16) uchar channel[16], gray[16];
+
+      for (int t = 0; t < 16; t++) {
+        const uchar value = static_cast<uchar>(r * 4 + t / 4);
+        channel[t] = t % 4 ? 0x80 : value;
+        gray[t] = t % 4 == 3 ? 0x80 : value;
+      }
+
+      channelRows[r] = _mm_load_si128(reinterpret_cast<__m128i *>(channel));
+      grayRows[r] = _mm_load_si128(reinterpret_cast<__m128i *>(gray));
+    }
+  }
+};
+
+const ShuffleTables &GetShuffleTables() {
+  static const ShuffleTables tables;
+  return tables;
+}
+} // namespace
+
+// Same as ColorPalette, as 4 texels.
+static __m128i ColorPalette(const uchar *block, bool fourColors) {
+  const int c0 = block[0] | (block[1] << 8);
+  const int c1 = block[2] | (block[3] << 8);
+  // 565 bit fields into 16 bit lanes: r g b of c0, then c1
+  const __m128i colors = _mm_setr_epi16(c0 >> 11, (c0 >> 5) & 0x3f, c0 & 0x1f,
+                                        0, c1 >> 11, (c1 >> 5) & 0x3f,
+                                        c1 & 0x1f, 0);
+  // c << 3 | c >> 2 and c << 2 | c >> 4 as multiplies
+  const __m128i high = _mm_setr_epi16(8, 4, 8, 0, 8, 4, 8, 0);
+  const __m128i low = _mm_setr_epi16(32, 8, 32, 0, 32, 8, 32, 0);
+  __m128i endpoints =
+      _mm_or_si128(_mm_mullo_epi16(colors, high),
+                   _mm_srli_epi16(_mm_mullo_epi16(colors, low), 7));
+  endpoints = _mm_or_si128(endpoints,
+                           _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255));
+
+  const __m128i a = _mm_unpacklo_epi64(endpoints, endpoints);
+  const __m128i b = _mm_unpackhi_epi64(endpoints, endpoints);
+  const bool interpolate = fourColors || c0 > c1;
+  const __m128i w0 = interpolate ? _mm_setr_epi16(2, 2, 2, 0, 1, 1, 1, 0)
+                                 : _mm_setr_epi16(1, 1, 1, 0, 0, 0, 0, 0);
+  const __m128i w1 = interpolate ? _mm_setr_epi16(1, 1, 1, 0, 2, 2, 2, 0)
+                                 : _mm_setr_epi16(1, 1, 1, 0, 0, 0, 0, 0);
+  const __m128i alpha = interpolate
+                            ? _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255)
+                            : _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 0);
+  const __m128i reciprocal =
+      _mm_set1_epi16(interpolate ? 21846 : static_cast<short>(32768));
+  __m128i mixed = _mm_add_epi16(_mm_mullo_epi16(w0, a), _mm_mullo_epi16(w1, b));
+  mixed = _mm_or_si128(_mm_mulhi_epu16(mixed, reciprocal), alpha);
+
+  return _mm_packus_epi16(endpoints, mixed);
+}
+
+// Same as ChannelPalette, in 8 bytes. Divisions by 7 and 5 are multiplied
+// by rounded up reciprocal, exact over whole 8 bit range.
+static __m128i ChannelPalette(const uchar *block) {
+  const __m128i a0 = _mm_set1_epi16(block[0]);
+  const __m128i a1 = _mm_set1_epi16(block[1]);
+  const __m128i eightValues = _mm_cmpgt_epi16(a0, a1);
+  const auto select = [&](__m128i eight, __m128i six) {
+    return _mm_or_si128(_mm_and_si128(eightValues, eight),
+                        _mm_andnot_si128(eightValues, six));
+  };
+  const __m128i w0 = select(_mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1),
+                            _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0));
+  const __m128i w1 = select(_mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6),
+                            _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0));
+  const __m128i reciprocal =
+      select(_mm_set1_epi16(9363), _mm_set1_epi16(13108));
+  const __m128i sum =
+      _mm_add_epi16(_mm_mullo_epi16(w0, a0), _mm_mullo_epi16(w1, a1));
+  __m128i values = _mm_mulhi_epu16(sum, reciprocal);
+  values = _mm_or_si128(
+      values, _mm_andnot_si128(eightValues,
+                               _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255)));
+
+  return _mm_packus_epi16(values, values);
+}
+
+// 16 channel values in texel order.
+static __m128i DecodeChannel(const uchar *block, const ShuffleTables &tables) {
+  const __m128i palette = ChannelPalette(block);
+  const uint64_t indices = ReadU64(block) >> 16;
+  const __m128i control = _mm_set_epi32(
+      static_cast<int>(tables.channelIndices[(indices >> 36) & 0xfff]),
+      static_cast<int>(tables.channelIndices[(indices >> 24) & 0xfff]),
+      static_cast<int>(tables.channelIndices[(indices >> 12) & 0xfff]),
+      static_cast<int>(tables.channelIndices[indices & 0xfff]));
+
+  return _mm_shuffle_epi8(palette, control);
+}
+
+// Places channel values of block row as 32 bit lanes.
+static __m128i ChannelRow(__m128i values, int row,
+                          const ShuffleTables &tables) {
+  return _mm_shuffle_epi8(values, tables.channelRows[row]);
+}
+
+static __m128i ReconstructZ(__m128i r, __m128i g) {
+  const __m128i half = _mm_set1_epi32(255);
+  const __m128i x = _mm_sub_epi32(_mm_slli_epi32(r, 1), half);
+  const __m128i y = _mm_sub_epi32(_mm_slli_epi32(g, 1), half);
+  const __m128i xy = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi32(0xffff)),
+                                  _mm_slli_epi32(y, 16));
+  __m128i d = _mm_sub_epi32(_mm_set1_epi32(255 * 255), _mm_madd_epi16(xy, xy));
+  d = _mm_andnot_si128(_mm_srai_epi32(d, 31), d);
+
+  __m128 z = _mm_sqrt_ps(_mm_cvtepi32_ps(d));
+  z = _mm_mul_ps(_mm_add_ps(z, _mm_set1_ps(255.f)), _mm_set1_ps(0.5f));
+  z = _mm_add_ps(z, _mm_set1_ps(0.5f));
+
+  return _mm_cvttps_epi32(z);
+}
+
+// Format is template argument, so every row walk has its own block decoder
+// without per block switch.
+template <XenoBCFormat format>
+static void DecodeBlockSSSE3(const uchar *block, uint32_t *out, size_t pitch,
+                             bool reconstructZ, const ShuffleTables &tables) {
+  const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xff000000));
+
+  switch (format) {
+  case XenoBC1:
+  case XenoBC2:
+  case XenoBC3: {
+    const uchar *colorBlock = format == XenoBC1 ? block : block + 8;
+    const __m128i colors = ColorPalette(colorBlock, format != XenoBC1);
+    const uint32_t indices = ReadU32(colorBlock + 4);
+    __m128i alphas = _mm_setzero_si128();
+
+    if (format == XenoBC2) {
+      const __m128i nibbles = _mm_loadl_epi64(
+          reinterpret_cast<const __m128i *>(block));
+      const __m128i mask = _mm_set1_epi8(0xf);
+      const __m128i low = _mm_and_si128(nibbles, mask);
+      const __m128i high = _mm_and_si128(_mm_srli_epi16(nibbles, 4), mask);
+      alphas = _mm_unpacklo_epi8(low, high);
+      // a * 17 == a << 4 | a for 4 bit a
+      alphas = _mm_or_si128(alphas, _mm_slli_epi16(alphas, 4));
+    } else if (format == XenoBC3)
+      alphas = DecodeChannel(block, tables);
+
+    for (int r = 0; r < 4; r++) {
+      __m128i row = _mm_shuffle_epi8(
+          colors, tables.colorRows[(indices >> (8 * r)) & 0xff]);
+
+      if (format != XenoBC1)
+        row = _mm_or_si128(_mm_andnot_si128(opaque, row),
+                           _mm_slli_epi32(ChannelRow(alphas, r, tables), 24));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + r * pitch), row);
+    }
+    break;
+  }
+  case XenoBC4: {
+    const __m128i values = DecodeChannel(block, tables);
+
+    for (int r = 0; r < 4; r++) {
+      const __m128i gray = _mm_shuffle_epi8(values, tables.grayRows[r]);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + r * pitch),
+                       _mm_or_si128(gray, opaque));
+    }
+    break;
+  }
+  case XenoBC5: {
+    const __m128i red = DecodeChannel(block, tables);
+    const __m128i green = DecodeChannel(block + 8, tables);
+
+    for (int r = 0; r < 4; r++) {
+      const __m128i redRow = ChannelRow(red, r, tables);
+      const __m128i greenRow = ChannelRow(green, r, tables);
+      __m128i row =
+          _mm_or_si128(_mm_or_si128(redRow, _mm_slli_epi32(greenRow, 8)),
+                       opaque);
+
+      if (reconstructZ)
+        row = _mm_or_si128(row,
+                           _mm_slli_epi32(ReconstructZ(redRow, greenRow), 16));
+
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + r * pitch), row);
+    }
+    break;
+  }
+  }
+}
+
+template <XenoBCFormat format>
+static void DecodeRowSSSE3(const uchar *blocks, int width, int numRows,
+                           uchar *out, size_t stride, bool reconstructZ) {
+  const ShuffleTables &tables = GetShuffleTables();
+  DecodeRow(format, blocks, width, numRows, out, stride,
+            [&](const uchar *block, uint32_t *texels, size_t pitch) {
+              DecodeBlockSSSE3<format>(block, texels, pitch, reconstructZ,
+                                       tables);
+            });
+}
+#endif
+
+void XenoDecodeBCRowSSSE3(XenoBCFormat format, const uchar *blocks, int width,
+                          int numRows, uchar *out, size_t stride,
+                          bool reconstructZ) {
+#ifdef XENO_SSSE3
+  switch (format) {
+  case XenoBC1:
+    DecodeRowSSSE3<XenoBC1>(blocks, width, numRows, out, stride, reconstructZ);
+    break;
+  case XenoBC2:
+    DecodeRowSSSE3<XenoBC2>(blocks, width, numRows, out, stride, reconstructZ);
+    break;
+  case XenoBC3:
+    DecodeRowSSSE3<XenoBC3>(blocks, width, numRows, out, stride, reconstructZ);
+    break;
+  case XenoBC4:
+    DecodeRowSSSE3<XenoBC4>(blocks, width, numRows, out, stride, reconstructZ);
+    break;
+  case XenoBC5:
+    DecodeRowSSSE3<XenoBC5>(blocks, width, numRows, out, stride, reconstructZ);
+    break;
+  }
+#else
+  XenoDecodeBCRowScalar(format, blocks, width, numRows, out, stride,
+                        reconstructZ);
+#endif
+}
@@ -0,0 +1,1114 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "XenoBench.h"
+#include "XenoAnim.h"
+#include "XenoBCn.h"
+#include "XenoDecode.h"
+#include "XenoPNG.h"
+#include "XenoScene.h"
+#include "XenoThreads.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "datas/esstring.h"
+#include "datas/fileinfo.hpp"
+
+static double Measure(const std::function<void()> &func, int numRuns = 10) {
+  double best = 1e30;
+
+  for (int r = 0; r < numRuns; r++) {
+    auto start = std::chrono::steady_clock::now();
+    func();
+    const double elapsed = std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+
+    if (elapsed < best)
+      best = elapsed;
+  }
+
+  return best;
+}
+
+static void Report(const char *name, double reference, double fast) {
+  printf("%-24s reference %9.3f ms, fast %9.3f ms, %6.2fx\n", name, reference,
+         fast, reference / fast);
+}
+
+static bool Compare(const float *a, const float *b, size_t count,
+                    float epsilon = 0.f) {
+  for (size_t i = 0; i < count; i++) {
+    const float diff = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+
+    if (diff > epsilon)
+      return false;
+  }
+
+  return true;
+}
+
+// Per vertex copy, scale and correction, same as importer did it before.
+static void __attribute__((noinline))
+ScalarPositions(const Vector *in, Vector *out, int count, float scale) {
+  for (int v = 0; v < count; v++) {
+    Vector temp;
+    memcpy(&temp, in + v, sizeof(Vector));
+    out[v] = XenoCorrectAxis(temp * scale);
+  }
+}
+
+static int BenchPositions() {
+  const int numVerts = 1 << 20;
+  const float scale = 145.f;
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> dist(-10.f, 10.f);
+  std::vector<Vector> source(numVerts), reference(numVerts), fast(numVerts);
+
+  for (auto &v : source)
+    v = Vector(dist(rng), dist(rng), dist(rng));
+
+  const double refTime =
+      Measure([&] { ScalarPositions(source.data(), reference.data(),
+                                    numVerts, scale); });
+  const double fastTime = Measure([&] {
+    memcpy(fast.data(), source.data(), numVerts * sizeof(Vector));
+    XenoTransformPositions(fast.data(), numVerts, scale);
+  });
+
+  Report("positions", refTime, fastTime);
+
+  return !Compare(&reference[0].X, &fast[0].X, numVerts * 3);
+}
+
+static void __attribute__((noinline))
+ScalarNormals(const XenoStream &stream, XenoNormalFormat format, Vector *out) {
+  for (int v = 0; v < stream.count; v++) {
+    const char *data = stream.data + v * stream.stride;
+    Vector temp;
+
+    switch (format) {
+    case XenoNormal_SNORM8: {
+      const signed char *comps = reinterpret_cast<const signed char *>(data);
+      temp = Vector(comps[0] / 127.f, comps[1] / 127.f, comps[2] / 127.f);
+      break;
+    }
+    default:
+      memcpy(&temp, data, sizeof(temp));
+      break;
+    }
+
+    const float length =
+        sqrtf(temp.X * temp.X + temp.Y * temp.Y + temp.Z * temp.Z);
+
+    if (length > 0.f)
+      temp *= 1.f / length;
+
+    out[v] = XenoCorrectAxis(temp);
+  }
+}
+
+static int BenchNormals() {
+  static const struct {
+    const char *name;
+    XenoNormalFormat format;
+    int stride;
+  } formats[] = {
+      {"normals SNORM8", XenoNormal_SNORM8, 32},
+      {"normals SNORM8 packed", XenoNormal_SNORM8, 4},
+      {"normals float", XenoNormal_Float, 32},
+  };
+
+  const int numVerts = 1 << 20;
+  std::mt19937 rng(2);
+  std::uniform_int_distribution<int> dist(-127, 127);
+  std::vector<char> source(numVerts * 32);
+  std::vector<Vector> reference(numVerts), fast(numVerts);
+  int result = 0;
+
+  for (auto &f : formats) {
+    for (int v = 0; v < numVerts; v++) {
+      char *data = &source[v * f.stride];
+
+      if (f.format == XenoNormal_SNORM8) {
+        for (int c = 0; c < 4; c++)
+          data[c] = static_cast<char>(dist(rng));
+      } else {
+        const float comps[] = {dist(rng) / 127.f, dist(rng) / 127.f,
+                               dist(rng) / 127.f};
+        memcpy(data, comps, sizeof(comps));
+      }
+    }
+
+    const XenoStream stream{source.data(), f.stride, numVerts};
+    const double refTime =
+        Measure([&] { ScalarNormals(stream, f.format, reference.data()); });
+    const double fastTime =
+        Measure([&] { XenoUnpackNormals(stream, f.format, fast.data()); });
+
+    Report(f.name, refTime, fastTime);
+
+    if (!Compare(&reference[0].X, &fast[0].X, numVerts * 3, 1e-5f))
+      result = 1;
+  }
+
+  return result;
+}
+
+// Stand-in for polymorphic MXMDVertexDescriptor, one virtual call per element.
+class BenchDescriptor {
+public:
+  XenoStream stream;
+  XenoVertexFormat format;
+
+  virtual void Evaluate(int at, void *data) const;
+  virtual ~BenchDescriptor() {}
+};
+
+void BenchDescriptor::Evaluate(int at, void *data) const {
+  const char *item = stream.data + at * stream.stride;
+  float *fData = static_cast<float *>(data);
+  const uchar *bytes = reinterpret_cast<const uchar *>(item);
+
+  switch (format) {
+  case XenoFormat_Float2:
+    memcpy(data, item, 8);
+    break;
+  case XenoFormat_Float3:
+    memcpy(data, item, 12);
+    break;
+  case XenoFormat_UNORM8x4:
+    for (int c = 0; c < 4; c++)
+      fData[c] = bytes[c] * (1.f / 255.f);
+    break;
+  case XenoFormat_UShort:
+    memcpy(data, item, 2);
+    break;
+  case XenoFormat_Int:
+    memcpy(data, item, 4);
+    break;
+  default:
+    break;
+  }
+}
+
+static void __attribute__((noinline))
+EvaluateDescriptor(const BenchDescriptor *d, XenoAttribute attribute,
+                   int count, void *out) {
+  for (int v = 0; v < count; v++) {
+    switch (attribute) {
+    case XenoAttr_Position:
+      d->Evaluate(v, static_cast<Vector *>(out) + v);
+      break;
+    case XenoAttr_UV: {
+      Vector2 temp;
+      d->Evaluate(v, &temp);
+      static_cast<Vector *>(out)[v] = Vector(temp.X, 1.f - temp.Y, 0.f);
+      break;
+    }
+    case XenoAttr_Color:
+      d->Evaluate(v, static_cast<Vector4 *>(out) + v);
+      break;
+    case XenoAttr_WeightID:
+      d->Evaluate(v, static_cast<ushort *>(out) + v);
+      break;
+    case XenoAttr_MorphID:
+      d->Evaluate(v, static_cast<int *>(out) + v);
+      break;
+    }
+  }
+}
+
+static int BenchFormats() {
+  struct FormatCase {
+    const char *name;
+    XenoAttribute attribute;
+    XenoVertexFormat format;
+    int stride;
+    int outSize;
+  };
+
+  static const FormatCase cases[] = {
+      {"position float3", XenoAttr_Position, XenoFormat_Float3, 32, 12},
+      {"uv float2", XenoAttr_UV, XenoFormat_Float2, 32, 12},
+      {"color unorm8x4", XenoAttr_Color, XenoFormat_UNORM8x4, 32, 16},
+      {"weight id ushort", XenoAttr_WeightID, XenoFormat_UShort, 32, 2},
+      {"morph id int", XenoAttr_MorphID, XenoFormat_Int, 4, 4},
+      {"uv float2 stride 68", XenoAttr_UV, XenoFormat_Float2, 68, 12},
+  };
+
+  const int numVerts = 1 << 20;
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  int result = 0;
+
+  for (auto &c : cases) {
+    std::vector<char> source(numVerts * c.stride);
+
+    for (int v = 0; v < numVerts; v++) {
+      char *data = &source[v * c.stride];
+
+      if (c.format == XenoFormat_Float2 || c.format == XenoFormat_Float3) {
+        for (int i = 0; i < 3; i++) {
+          const float value = dist(rng);
+          memcpy(data + i * 4, &value, sizeof(value));
+        }
+      } else {
+        for (int i = 0; i < 4; i++)
+          data[i] = static_cast<char>(rng());
+      }
+    }
+
+    BenchDescriptor desc;
+    desc.stream = {source.data(), c.stride, numVerts};
+    desc.format = c.format;
+
+    XenoDecodeFunc func = XenoGetDecoder(c.attribute, c.format, c.stride);
+    std::vector<char> reference(numVerts * c.outSize),
+        fast(numVerts * c.outSize);
+
+    const double refTime = Measure([&] {
+      EvaluateDescriptor(&desc, c.attribute, numVerts, reference.data());
+    });
+    const double fastTime = Measure([&] { func(desc.stream, fast.data()); });
+
+    Report(c.name, refTime, fastTime);
+
+    if (memcmp(reference.data(), fast.data(), reference.size()))
+      result = 1;
+  }
+
+  return result;
+}
+
+// Per face corner scan over all deltas, same as importer did it before.
+static void __attribute__((noinline))
+ScanMorphDeltas(const int *IDS, const Vector *deltas, int count,
+                const USVector *faces, int numFaces, std::vector<bool> &visited,
+                std::vector<int> &outIndices, std::vector<Vector> &outDeltas) {
+  std::fill(visited.begin(), visited.end(), false);
+
+  for (int f = 0; f < numFaces; f++) {
+    for (int s = 0; s < 3; s++) {
+      const int cfseg = faces[f][s];
+
+      if (visited[cfseg])
+        continue;
+
+      for (int i = 0; i < count; i++)
+        if (cfseg == IDS[i]) {
+          outIndices.push_back(cfseg);
+          outDeltas.push_back(deltas[i]);
+        }
+
+      visited[cfseg] = true;
+    }
+  }
+}
+
+// Synthetic face rig, many targets, each touching few percent of vertices.
+static int BenchMorphs() {
+  const int numVerts = 8000;
+  const int numUsedVerts = 7900;
+  const int numFaces = 16000;
+  const int numTargets = 80;
+  const int numDeltas = numVerts / 20;
+  std::mt19937 rng(4);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  std::vector<USVector> faces(numFaces);
+  std::vector<int> remap(numVerts, -1);
+
+  for (int f = 0; f < numFaces; f++)
+    for (int s = 0; s < 3; s++) {
+      const int vertexID = f * 3 + s < numUsedVerts ? f * 3 + s
+                                                     : rng() % numUsedVerts;
+      faces[f][s] = static_cast<ushort>(vertexID);
+      remap[vertexID] = 0;
+    }
+
+  int numUsed = 0;
+
+  for (auto &r : remap)
+    if (!r)
+      r = numUsed++;
+
+  std::vector<std::vector<int>> IDS(numTargets);
+  std::vector<std::vector<Vector>> deltas(numTargets);
+
+  for (int t = 0; t < numTargets; t++) {
+    // Isolated vertices and duplicates included
+    for (int d = 0; d < numDeltas; d++) {
+      IDS[t].push_back(rng() % numVerts);
+      deltas[t].push_back(Vector(dist(rng), dist(rng), dist(rng)));
+    }
+  }
+
+  std::vector<std::vector<int>> refIndices(numTargets), fastIndices(numTargets);
+  std::vector<std::vector<Vector>> refDeltas(numTargets),
+      fastDeltas(numTargets);
+  std::vector<bool> visited(numVerts);
+
+  const double refTime = Measure(
+      [&] {
+        for (int t = 0; t < numTargets; t++) {
+          refIndices[t].clear();
+          refDeltas[t].clear();
+          ScanMorphDeltas(IDS[t].data(), deltas[t].data(), numDeltas,
+                          faces.data(), numFaces, visited, refIndices[t],
+                          refDeltas[t]);
+        }
+      },
+      3);
+  const double fastTime = Measure([&] {
+    for (int t = 0; t < numTargets; t++) {
+      fastIndices[t].clear();
+      fastDeltas[t].clear();
+      XenoRemapMorphDeltas(IDS[t].data(), deltas[t].data(), numDeltas,
+                           remap.data(), numVerts, fastIndices[t],
+                           fastDeltas[t]);
+    }
+  });
+
+  Report("morphs", refTime, fastTime);
+
+  // Order differs, compare resulting channels, later duplicates win
+  std::vector<Vector> refChannel(numUsed), fastChannel(numUsed);
+
+  for (int t = 0; t < numTargets; t++) {
+    std::fill(refChannel.begin(), refChannel.end(), Vector());
+    std::fill(fastChannel.begin(), fastChannel.end(), Vector());
+
+    for (size_t d = 0; d < refIndices[t].size(); d++)
+      refChannel[remap[refIndices[t][d]]] = refDeltas[t][d];
+
+    for (size_t d = 0; d < fastIndices[t].size(); d++)
+      fastChannel[fastIndices[t][d]] = fastDeltas[t][d];
+
+    if (refIndices[t].size() != fastIndices[t].size() ||
+        !Compare(&refChannel[0].X, &fastChannel[0].X, numUsed * 3))
+      return 1;
+  }
+
+  return 0;
+}
+
+// Per sample key search and interpolation, array of structures.
+static void __attribute__((noinline))
+ScalarSampleTrack(const std::vector<float> &sampleTimes,
+                  const XenoTransform *samples,
+                  const std::vector<float> &frameTimes, XenoTransform *out) {
+  const int numSamples = static_cast<int>(sampleTimes.size());
+  const int numFrames = static_cast<int>(frameTimes.size());
+
+  for (int f = 0; f < numFrames; f++) {
+    const float t = frameTimes[f];
+    const int next = static_cast<int>(
+        std::upper_bound(sampleTimes.begin(), sampleTimes.end(), t) -
+        sampleTimes.begin());
+
+    if (next >= numSamples) {
+      out[f] = samples[numSamples - 1];
+      continue;
+    }
+
+    const int s = next - 1;
+    const float w = (t - sampleTimes[s]) / (sampleTimes[next] - sampleTimes[s]);
+    const XenoTransform &a = samples[s];
+    const XenoTransform &b = samples[next];
+    XenoTransform &r = out[f];
+
+    // Same snapping to source samples as sample grid
+    if (w < 1e-4f) {
+      r = a;
+      continue;
+    } else if (w > 1.f - 1e-4f) {
+      r = b;
+      continue;
+    }
+
+    r.position = a.position + (b.position - a.position) * w;
+    r.scale = a.scale + (b.scale - a.scale) * w;
+
+    const float dot =
+        a.rotation.X * b.rotation.X + a.rotation.Y * b.rotation.Y +
+        a.rotation.Z * b.rotation.Z + a.rotation.W * b.rotation.W;
+    const float sign = dot < 0.f ? -1.f : 1.f;
+    float q[4];
+
+    for (int c = 0; c < 4; c++)
+      q[c] = a.rotation[c] + (b.rotation[c] * sign - a.rotation[c]) * w;
+
+    const float length = sqrtf(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] +
+                               q[3] * q[3]);
+    r.rotation = Vector4(q[0] / length, q[1] / length, q[2] / length,
+                         q[3] / length);
+  }
+}
+
+// Long motion, many bones, 30 fps source baked at 60 fps.
+static int BenchTracks() {
+  const int numBones = 300;
+  const int numSamples = 1801;
+  const float sampleTime = 1.f / 30.f;
+  const int numFrames = 3601;
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  std::vector<float> sampleTimes(numSamples), frameTimes(numFrames);
+
+  for (int i = 0; i < numSamples; i++)
+    sampleTimes[i] = i * sampleTime;
+
+  for (int f = 0; f < numFrames; f++)
+    frameTimes[f] = f / 60.f;
+
+  std::vector<std::vector<XenoTransform>> samples(numBones);
+
+  // Random walk, real tracks are smooth between source samples
+  for (auto &b : samples) {
+    b.resize(numSamples);
+    XenoTransform current;
+    current.position = Vector(dist(rng), dist(rng), dist(rng));
+    current.scale = Vector(1.f, 1.f, 1.f);
+    current.rotation = Vector4(dist(rng), dist(rng), dist(rng), dist(rng));
+
+    for (auto &s : b) {
+      current.position =
+          current.position + Vector(dist(rng), dist(rng), dist(rng)) * 0.05f;
+      current.scale =
+          current.scale + Vector(dist(rng), dist(rng), dist(rng)) * 0.01f;
+      Vector4 &q = current.rotation;
+
+      for (int c = 0; c < 4; c++)
+        q[c] += dist(rng) * 0.05f;
+
+      const float length =
+          sqrtf(q.X * q.X + q.Y * q.Y + q.Z * q.Z + q.W * q.W);
+      q = Vector4(q.X / length, q.Y / length, q.Z / length, q.W / length);
+      s = current;
+    }
+  }
+
+  std::vector<std::vector<float>> soaSamples(numBones * 10);
+
+  for (int b = 0; b < numBones; b++)
+    for (int c = 0; c < 10; c++) {
+      std::vector<float> &comp = soaSamples[b * 10 + c];
+      comp.resize(numSamples);
+
+      for (int i = 0; i < numSamples; i++) {
+        const XenoTransform &s = samples[b][i];
+        comp[i] = c < 3 ? s.position[c]
+                        : c < 7 ? s.rotation[c - 3] : s.scale[c - 7];
+      }
+    }
+
+  std::vector<std::vector<XenoTransform>> reference(
+      numBones, std::vector<XenoTransform>(numFrames));
+  std::vector<XenoAnimTrack> fast(numBones);
+
+  const double refTime = Measure([&] {
+    for (int b = 0; b < numBones; b++)
+      ScalarSampleTrack(sampleTimes, samples[b].data(), frameTimes,
+                        reference[b].data());
+  });
+  const double fastTime = Measure([&] {
+    const XenoSampleGrid grid =
+        XenoBuildSampleGrid(frameTimes, sampleTime, numSamples);
+
+    for (int b = 0; b < numBones; b++) {
+      XenoAnimTrack &track = fast[b];
+      const float *rotationSamples[4];
+      float *rotationFrames[4];
+
+      for (int c = 0; c < 4; c++) {
+        track.rotation[c].resize(numFrames);
+        rotationSamples[c] = soaSamples[b * 10 + 3 + c].data();
+        rotationFrames[c] = track.rotation[c].data();
+      }
+
+      XenoResampleRotation(rotationSamples, grid, rotationFrames);
+
+      for (int c = 0; c < 3; c++) {
+        track.position[c].resize(numFrames);
+        track.scale[c].resize(numFrames);
+        XenoResampleLinear(soaSamples[b * 10 + c].data(), grid,
+                           track.position[c].data());
+        XenoResampleLinear(soaSamples[b * 10 + 7 + c].data(), grid,
+                           track.scale[c].data());
+      }
+    }
+  });
+
+  Report("tracks", refTime, fastTime);
+
+  for (int b = 0; b < numBones; b++)
+    for (int f = 0; f < numFrames; f++) {
+      const XenoTransform ref = reference[b][f];
+      const XenoTransform tm = fast[b].GetFrame(f);
+      // q and -q are same rotation, sides may differ at snapped frames
+      const Vector4 negated(-tm.rotation.X, -tm.rotation.Y, -tm.rotation.Z,
+                            -tm.rotation.W);
+
+      const float epsilon = 1e-5f;
+
+      if (!Compare(&ref.position.X, &tm.position.X, 3, epsilon) ||
+          !Compare(&ref.scale.X, &tm.scale.X, 3, epsilon) ||
+          (!Compare(&ref.rotation.X, &tm.rotation.X, 4, epsilon) &&
+           !Compare(&ref.rotation.X, &negated.X, 4, epsilon)))
+        return 1;
+    }
+
+  return 0;
+}
+
+// 4K textures of random blocks, every bit pattern is valid BCn.
+// Reference is per pixel decoder over single thread, fast path runs
+// vectorized decoder over pool. Odd sized image covers edge blocks.
+static int BenchBCn() {
+  static const struct {
+    const char *name;
+    XenoBCFormat format;
+    bool reconstructZ;
+  } formats[] = {
+      {"bc1", XenoBC1, false}, {"bc2", XenoBC2, false},
+      {"bc3", XenoBC3, false}, {"bc4", XenoBC4, false},
+      {"bc5", XenoBC5, false}, {"bc5 z", XenoBC5, true},
+  };
+
+  const int size = 4096;
+  const int oddWidth = 1023;
+  const int oddHeight = 517;
+  std::mt19937 rng(6);
+  std::vector<uchar> blocks(static_cast<size_t>(size) * size);
+  std::vector<uchar> reference(static_cast<size_t>(size) * size * 4),
+      fast(reference.size());
+  XenoThreadPool pool;
+
+  for (auto &b : blocks)
+    b = static_cast<uchar>(rng());
+
+  for (auto &f : formats) {
+    auto decodeScalar = [&](int width, int height) {
+      const size_t rowSize =
+          static_cast<size_t>((width + 3) / 4) * XenoBCBlockSize(f.format);
+
+      for (int r = 0; r < height; r += 4)
+        XenoDecodeBCRowScalar(f.format, blocks.data() + rowSize * r / 4,
+                              width, height - r < 4 ? height - r : 4,
+                              reference.data() + width * 4 * r, width * 4,
+                              f.reconstructZ);
+    };
+
+    const double refTime = Measure([&] { decodeScalar(size, size); });
+    const double fastTime = Measure([&] {
+      XenoDecodeBC(f.format, blocks.data(), size, size, fast.data(),
+                   f.reconstructZ, &pool);
+    });
+
+    char name[32];
+    snprintf(name, sizeof(name), "%s, %d threads", f.name,
+             pool.NumThreads());
+    Report(name, refTime, fastTime);
+
+    if (reference != fast)
+      return 1;
+
+    decodeScalar(oddWidth, oddHeight);
+    XenoDecodeBC(f.format, blocks.data(), oddWidth, oddHeight, fast.data(),
+                 f.reconstructZ, &pool);
+
+    if (memcmp(reference.data(), fast.data(),
+               static_cast<size_t>(oddWidth) * oddHeight * 4))
+      return 1;
+  }
+
+  return 0;
+}
+
+// Both PNG profiles over texture like 4K images, reference encodes strips
+// on single thread. Output must not depend on number of threads.
+static int BenchPNG() {
+  const int size = 4096;
+  const size_t rawSize = static_cast<size_t>(size) * size * 4;
+  std::mt19937 rng(7);
+  std::vector<uchar> albedo(rawSize), normal(rawSize);
+
+  for (int y = 0; y < size; y++)
+    for (int x = 0; x < size; x++) {
+      uchar *a = &albedo[(static_cast<size_t>(y) * size + x) * 4];
+      uchar *n = &normal[(static_cast<size_t>(y) * size + x) * 4];
+      const float wave = std::sin(x * 0.02f) * std::cos(y * 0.013f);
+      const int noise = static_cast<int>(rng() % 6);
+      a[0] = static_cast<uchar>(x * 200 / size + noise);
+      a[1] = static_cast<uchar>(96 + wave * 64 + noise);
+      a[2] = static_cast<uchar>(y * 160 / size + noise);
+      a[3] = 255;
+      n[0] = static_cast<uchar>(128 + wave * 60);
+      n[1] = static_cast<uchar>(128 + std::sin(y * 0.05f) * 60);
+      n[2] = 255;
+      n[3] = 255;
+    }
+
+  static const struct {
+    const char *name;
+    const std::vector<uchar> &image;
+  } images[] = {{"albedo", albedo}, {"normal", normal}};
+
+  static const struct {
+    const char *name;
+    XenoPNGProfile profile;
+  } profiles[] = {{"fast", XenoPNG_Fast}, {"max", XenoPNG_Max}};
+
+  XenoThreadPool pool;
+
+  for (auto &i : images)
+    for (auto &p : profiles) {
+      std::vector<uchar> reference, fast;
+      const double refTime = Measure(
+          [&] {
+            reference =
+                XenoEncodePNG(i.image.data(), size, size, p.profile, nullptr);
+          },
+          p.profile == XenoPNG_Max ? 1 : 3);
+      const double fastTime = Measure(
+          [&] {
+            fast = XenoEncodePNG(i.image.data(), size, size, p.profile, &pool);
+          },
+          p.profile == XenoPNG_Max ? 1 : 3);
+
+      char name[32];
+      snprintf(name, sizeof(name), "png %s %s, %d threads", i.name, p.name,
+               pool.NumThreads());
+      Report(name, refTime, fastTime);
+      printf("%-24s 1 thread %.1f MB/s, %zu kB, %.1f%% of raw\n", "",
+             rawSize / (refTime * 1e3), fast.size() >> 10,
+             fast.size() * 100.0 / rawSize);
+
+      if (reference != fast)
+        return 1;
+    }
+
+  return 0;
+}
+
+struct Benchmark {
+  const char *name;
+  int (*func)();
+};
+
+static const Benchmark benchmarks[] = {
+    {"positions", BenchPositions},
+    {"normals", BenchNormals},
+    {"formats", BenchFormats},
+    {"morphs", BenchMorphs},
+    {"tracks", BenchTracks},
+    {"bcn", BenchBCn},
+    {"png", BenchPNG},
+};
+
+int XenoRunBenchmarks(const char *filter) {
+  int result = 0;
+
+  for (auto &b : benchmarks) {
+    if (filter && !strstr(b.name, filter))
+      continue;
+
+    if (b.func()) {
+      printf("%s: fast path output mismatch\n", b.name);
+      result = 1;
+    }
+  }
+
+  return result;
+}
+
+namespace {
+struct VerifyStats {
+  const char *name;
+  int numDescriptors = 0;
+  int numEvaluated = 0;
+  int numMismatches = 0;
+  size_t numItems = 0;
+  double refTime = 0.0;
+  double fastTime = 0.0;
+};
+
+struct VerifyItem {
+  MXMDVertexDescriptor *desc;
+  int count;
+};
+} // namespace
+
+static bool GetVerifyAttribute(MXMDVertexDescriptor *d, XenoAttribute &attr,
+                               int &outSize, const char *&name) {
+  switch (d->Type()) {
+  case MXMD_POSITION:
+    attr = XenoAttr_Position;
+    outSize = sizeof(Vector);
+    name = "position";
+    return true;
+  case MXMD_UV1:
+  case MXMD_UV2:
+  case MXMD_UV3:
+    attr = XenoAttr_UV;
+    outSize = sizeof(Vector);
+    name = "uv";
+    return true;
+  case MXMD_VERTEXCOLOR:
+    attr = XenoAttr_Color;
+    outSize = sizeof(Vector4);
+    name = "vertex color";
+    return true;
+  case MXMD_WEIGHTID:
+    attr = XenoAttr_WeightID;
+    outSize = sizeof(ushort);
+    name = "weight id";
+    return true;
+  case MXMD_MORPHVERTEXID:
+    attr = XenoAttr_MorphID;
+    outSize = sizeof(int);
+    name = "morph vertex id";
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Unpacker against Evaluate and XenoTransformNormals, same as fallback.
+static void VerifyNormals(const VerifyItem &item, VerifyStats &stat) {
+  XenoNormalFormat format;
+
+  if (!XenoGetNormalFormat(item.desc, format)) {
+    stat.numEvaluated++;
+    return;
+  }
+
+  std::vector<Vector> reference(item.count), fast(item.count);
+
+  stat.refTime += Measure(
+      [&] {
+        for (int v = 0; v < item.count; v++) {
+          Vector4 temp;
+          item.desc->Evaluate(v, &temp);
+          reference[v] = Vector(temp.X, temp.Y, temp.Z);
+        }
+
+        XenoTransformNormals(reference.data(), item.count);
+      },
+      1);
+  stat.fastTime += Measure(
+      [&] { XenoDecodeNormals(item.desc, item.count, fast.data()); }, 1);
+  stat.numItems += item.count;
+
+  if (!Compare(&reference[0].X, &fast[0].X, item.count * 3, 1e-5f))
+    stat.numMismatches++;
+}
+
+// Fast path against Evaluate of the same descriptor.
+static void VerifyDescriptor(const VerifyItem &item,
+                             std::map<int, VerifyStats> &stats) {
+  const char *normalName = nullptr;
+
+  switch (item.desc->Type()) {
+  case MXMD_NORMAL:
+    normalName = "normal";
+    break;
+  case MXMD_NORMAL2:
+    normalName = "normal2";
+    break;
+  case MXMD_NORMAL32:
+    normalName = "normal32";
+    break;
+  case MXMD_NORMALMORPH:
+    normalName = "morph normal";
+    break;
+  default:
+    break;
+  }
+
+  if (normalName) {
+    VerifyStats &stat = stats[item.desc->Type()];
+    stat.name = normalName;
+    stat.numDescriptors++;
+
+    if (item.count)
+      VerifyNormals(item, stat);
+    return;
+  }
+
+  XenoAttribute attribute;
+  int outSize;
+  const char *name;
+
+  if (!GetVerifyAttribute(item.desc, attribute, outSize, name))
+    return;
+
+  VerifyStats &stat = stats[item.desc->Type()];
+  stat.name = name;
+  stat.numDescriptors++;
+
+  const XenoAttributeDecoder fast = XenoSelectDecoder(item.desc, attribute);
+
+  if (!fast.decode) {
+    stat.numEvaluated++;
+    return;
+  }
+
+  XenoAttributeDecoder reference = fast;
+  reference.format = XenoFormat_Evaluate;
+  reference.decode = nullptr;
+
+  const size_t size = static_cast<size_t>(item.count) * outSize;
+  std::vector<char> refData(size), fastData(size);
+
+  stat.refTime += Measure(
+      [&] {
+        XenoDecodeAttribute(item.desc, reference, 0, item.count,
+                            refData.data());
+      },
+      1);
+  stat.fastTime += Measure(
+      [&] {
+        XenoDecodeAttribute(item.desc, fast, 0, item.count, fastData.data());
+      },
+      1);
+  stat.numItems += item.count;
+
+  if (refData != fastData)
+    stat.numMismatches++;
+}
+
+static int VerifyMeshes(MXMD &model) {
+  MXMDModel::Ptr mdl = model.GetModel();
+
+  if (!mdl)
+    return 0;
+
+  // Collections keep their descriptors alive until verified
+  std::vector<MXMDVertexBuffer::DescriptorCollection> collections;
+  std::vector<VerifyItem> items;
+  const int numGroups = mdl->GetNumMeshGroups();
+
+  for (int g = 0; g < numGroups; g++) {
+    MXMDGeomBuffers::Ptr geom = model.GetGeometry(g);
+
+    if (!geom)
+      continue;
+
+    MXMDMeshGroup::Ptr group = mdl->GetMeshGroup(g);
+    const int numMeshes = group->GetNumMeshObjects();
+    std::vector<bool> visited;
+
+    for (int m = 0; m < numMeshes; m++) {
+      const int bufferID = group->GetMeshObject(m)->GetBufferID();
+
+      if (bufferID >= static_cast<int>(visited.size()))
+        visited.resize(bufferID + 1);
+
+      if (visited[bufferID])
+        continue;
+
+      visited[bufferID] = true;
+      MXMDVertexBuffer::Ptr vBuffer = geom->GetVertexBuffer(bufferID);
+      const int numVerts = vBuffer->NumVertices();
+      collections.push_back(vBuffer->GetDescriptors());
+
+      for (auto &d : collections.back())
+        items.push_back({d.get(), numVerts});
+
+      MXMDMorphTargets::Ptr morphs =
+          geom->GetVertexBufferMorphTargets(bufferID);
+
+      if (!morphs)
+        continue;
+
+      collections.push_back(morphs->GetBaseMorph());
+
+      for (auto &d : collections.back())
+        items.push_back({d.get(), numVerts});
+
+      const int numMorphs = morphs->GetNumMorphs();
+
+      for (int t = 0; t < numMorphs; t++) {
+        collections.push_back(morphs->GetDeltaMorph(t));
+
+        for (auto &d : collections.back())
+          items.push_back({d.get(), d->Size()});
+      }
+    }
+  }
+
+  std::map<int, VerifyStats> stats;
+
+  for (auto &i : items)
+    VerifyDescriptor(i, stats);
+
+  int result = 0;
+
+  for (auto &s : stats) {
+    const VerifyStats &stat = s.second;
+    printf("%-16s %d descriptors, %d evaluated, %zu items\n", stat.name,
+           stat.numDescriptors, stat.numEvaluated, stat.numItems);
+
+    if (stat.numItems)
+      Report(stat.name, stat.refTime, stat.fastTime);
+
+    if (stat.numMismatches) {
+      printf("%-16s %d descriptors differ from Evaluate\n", stat.name,
+             stat.numMismatches);
+      result = 1;
+    }
+  }
+
+  return result;
+}
+
+static bool ReadFile(const TSTRING &path, std::vector<uchar> &data) {
+  std::ifstream stream(path.c_str(), std::ios::binary);
+
+  if (!stream)
+    return false;
+
+  data.assign(std::istreambuf_iterator<char>(stream),
+              std::istreambuf_iterator<char>());
+
+  return true;
+}
+
+// XenoDecodeBC of every texture against scalar decoder, on the same blocks.
+static int VerifyTextures(MXMD &model, const TSTRING &path) {
+  MXMDTextures::Ptr textures = model.GetTextures();
+
+  if (!textures)
+    return 0;
+
+  TFileInfo fleInfo(path);
+  const TSTRING folder =
+      fleInfo.GetPath() + fleInfo.GetFileName() + _T("_verify/");
+  mkdir(folder.c_str(), 0777);
+
+  static const char *formatNames[] = {"BC1", "BC2", "BC3", "BC4", "BC5"};
+  int numExact[5] = {}, numDiffer[5] = {}, maxDiff[5] = {};
+  int numUnsupported = 0, numFailed = 0;
+  const int numTextures = textures->GetNumTextures();
+  TextureConversionParams params;
+  params.allowBC5ZChan = true;
+  params.uncompress = false;
+
+  for (int t = 0; t < numTextures; t++) {
+    const TSTRING ddsPath =
+        folder + esStringConvert<TCHAR>(textures->GetTextureName(t)) +
+        _T(".dds");
+    std::vector<uchar> dds, fast;
+    int width = 0, height = 0;
+    XenoBCFormat format;
+
+    const bool extracted =
+        !textures->ExtractTexture(folder.c_str(), t, params) &&
+        ReadFile(ddsPath, dds);
+    std::remove(ddsPath.c_str());
+
+    if (!extracted) {
+      numFailed++;
+      continue;
+    }
+
+    if (!XenoDecodeDDS(dds, params.allowBC5ZChan, nullptr, fast, width, height,
+                       format)) {
+      numUnsupported++;
+      continue;
+    }
+
+    // XenoDecodeDDS validated header and size already
+    const size_t dataOffset = !memcmp(dds.data() + 84, "DX10", 4) ? 148 : 128;
+    const uchar *blocks = dds.data() + dataOffset;
+    const size_t rowSize =
+        static_cast<size_t>((width + 3) / 4) * XenoBCBlockSize(format);
+    const size_t stride = static_cast<size_t>(width) * 4;
+    std::vector<uchar> reference(fast.size());
+
+    for (int r = 0; r * 4 < height; r++)
+      XenoDecodeBCRowScalar(format, blocks + rowSize * r, width,
+                            std::min(height - r * 4, 4),
+                            reference.data() + stride * r * 4, stride,
+                            params.allowBC5ZChan);
+
+    int diff = 0;
+
+    for (size_t i = 0; i < fast.size(); i++)
+      diff = std::max(diff, abs(fast[i] - reference[i]));
+
+    if (diff) {
+      numDiffer[format]++;
+      maxDiff[format] = std::max(maxDiff[format], diff);
+    } else
+      numExact[format]++;
+  }
+
+  rmdir(folder.c_str());
+
+  int result = 0;
+
+  for (int f = 0; f < 5; f++) {
+    if (!numExact[f] && !numDiffer[f])
+      continue;
+
+    printf("%-16s %d textures bit exact, %d differ", formatNames[f],
+           numExact[f], numDiffer[f]);
+
+    if (numDiffer[f]) {
+      printf(", max difference %d", maxDiff[f]);
+      result = 1;
+    }
+
+    printf("\n");
+  }
+
+  if (numUnsupported)
+    printf("%-16s %d textures, left to XenoLib\n", "other formats",
+           numUnsupported);
+
+  if (numFailed) {
+    printf("%-16s %d textures failed to extract\n", "textures", numFailed);
+    result = 1;
+  }
+
+  return result;
+}
+
+int XenoVerifyModel(const TSTRING &path) {
+  MXMD model;
+
+  if (model.Load(path.c_str())) {
+    printf("Failed to load model\n");
+    return 1;
+  }
+
+  return VerifyMeshes(model) | VerifyTextures(model, path);
+}
@@ -0,0 +1,30 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Synthetic benchmarks of headless decoding kernels and their verification
+// against XenoLib.
+
+#pragma once
+#include "MXMD.h"
+
+// Runs every benchmark which name contains filter, nullptr runs all.
+// Returns non zero when fast path output differs from reference.
+int XenoRunBenchmarks(const char *filter);
+
+// Decodes every vertex descriptor of model through fast path and through
+// XenoLib Evaluate. Returns non zero when they differ.
+int XenoVerifyModel(const TSTRING &path);
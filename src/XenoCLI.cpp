@@ -0,0 +1,454 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Headless importer, runs whole decode pipeline without 3ds max.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "SAR.h"
+#include "XenoBench.h"
+#include "XenoScene.h"
+#include "XenoTexCache.h"
+#include "XenoThreads.h"
+
+#include "datas/esstring.h"
+#include "datas/fileinfo.hpp"
+#include "datas/masterprinter.hpp"
+
+struct CLISettings {
+  XenoSettings scene;
+  float frameRate = 30.f;
+  std::vector<int> motionIndices; // empty: all motions
+  std::vector<std::pair<int, int>> extraLODs; // group, level
+  bool textures = false;
+  bool toPNG = false;
+  XenoPNGProfile PNGProfile = XenoPNG_Max;
+  bool BC5BChan = false;
+  TSTRING textureCache;        // empty: no cache
+  int textureCacheSize = 2048; // MB
+};
+
+static void PrintLog(const TCHAR *msg) { fputs(msg, stderr); }
+
+struct Stopwatch {
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+
+  double Elapsed() const {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  }
+};
+
+static void PrintAnimation(const char *name, const XenoAnimation &anim) {
+  size_t numKeys = 0;
+
+  for (auto &t : anim.tracks)
+    for (auto &k : t.keys)
+      numKeys += k.size();
+
+  printf("  %s: %zu tracks, %zu frames, %zu keys\n", name, anim.tracks.size(),
+         anim.frameTimes.size(), numKeys);
+}
+
+static int LoadMXMD(const TSTRING &filename, const CLISettings &settings) {
+  MXMD mainModel;
+
+  if (mainModel.Load(filename.c_str()))
+    return 1;
+
+  Stopwatch timer;
+
+  if (settings.textures) {
+    MXMDTextures::Ptr textures = mainModel.GetTextures();
+
+    if (textures) {
+      TFileInfo fleInfo(filename);
+      TSTRING folderPath = fleInfo.GetPath() + fleInfo.GetFileName() + _T("/");
+      TextureConversionParams params;
+      params.allowBC5ZChan = !settings.BC5BChan;
+      params.uncompress = settings.toPNG;
+
+      mkdir(folderPath.c_str(), 0777);
+
+      std::unique_ptr<XenoTextureCache> texCache;
+
+      if (settings.textureCache.size())
+        texCache.reset(new XenoTextureCache(
+            settings.textureCache,
+            static_cast<uint64_t>(settings.textureCacheSize) << 20));
+
+      XenoThreadPool texPool(settings.scene.numTextureThreads);
+      XenoExtractTextures(textures, folderPath, params, settings.PNGProfile,
+                          texPool, nullptr, texCache.get(), filename);
+      texPool.Wait();
+      printf("  %d textures extracted in %.2f ms, %d threads%s\n",
+             textures->GetNumTextures(), timer.Elapsed(),
+             texPool.NumThreads(),
+             settings.toPNG && settings.PNGProfile == XenoPNG_Fast
+                 ? ", fast PNG"
+                 : "");
+
+      if (texCache)
+        printf("  texture cache: %zu hits, %zu misses\n", texCache->hits,
+               texCache->misses);
+      timer = Stopwatch();
+    }
+  }
+
+  MXMDModel::Ptr mdl = mainModel.GetModel();
+
+  if (!mdl)
+    return 0;
+
+  std::vector<XenoPoseBone> bones =
+      XenoDecodeModelPose(mdl, settings.scene);
+  std::vector<XenoInstance> instances =
+      XenoDecodeInstances(&mainModel, settings.scene);
+
+  const int numGroups = mdl->GetNumMeshGroups();
+  size_t numMeshes = 0, numVerts = 0, numFaces = 0, numMorphs = 0;
+  std::vector<int> groups(numGroups);
+
+  for (int g = 0; g < numGroups; g++)
+    groups[g] = g;
+
+  XenoThreadPool pool(settings.scene.numThreads);
+  XenoMeshCache cache;
+  std::vector<std::vector<XenoMesh>> groupMeshes = XenoDecodeMeshGroups(
+      &mainModel, mdl, groups, settings.scene, pool, cache);
+
+  size_t numObjects = 0;
+
+  for (int g = 0; g < numGroups; g++)
+    numObjects += mdl->GetMeshGroup(g)->GetNumMeshObjects();
+
+  for (auto &meshes : groupMeshes) {
+    for (auto &m : meshes) {
+      numVerts += m.buffers->positions.size();
+      numFaces += m.buffers->faces.size();
+      numMorphs += m.buffers->morphs.size();
+    }
+
+    numMeshes += meshes.size();
+  }
+
+  printf("  %zu bones, %zu instances, %d groups, %zu meshes, %zu vertices, "
+         "%zu faces, %zu morphs\n",
+         bones.size(), instances.size(), numGroups, numMeshes, numVerts,
+         numFaces, numMorphs);
+  printf("  %zu LOD objects skipped\n", numObjects - numMeshes);
+
+  // Skipped levels are decoded on demand, while model is still loaded
+  for (auto &l : settings.extraLODs) {
+    if (l.first < 0 || l.first >= numGroups) {
+      printf("  group %d doesn't exist\n", l.first);
+      continue;
+    }
+
+    std::vector<XenoMesh> LODMeshes = XenoDecodeMeshLOD(
+        &mainModel, mdl, l.first, l.second, settings.scene, pool, cache);
+    printf("  group %d LOD %d: %zu meshes decoded on demand\n", l.first,
+           l.second, LODMeshes.size());
+  }
+
+  printf("  buffer cache: %zu hits, %zu misses\n", cache.hits, cache.misses);
+  printf("  palette cache: %zu hits, %zu misses\n", cache.paletteHits,
+         cache.paletteMisses);
+  printf("  decoded in %.2f ms, %d threads\n", timer.Elapsed(),
+         pool.NumThreads());
+
+  return 0;
+}
+
+static int LoadSkeleton(BC &sklFile, const CLISettings &settings) {
+  BCSKEL *skl = sklFile.GetClass<BCSKEL>();
+
+  if (!skl)
+    return -1;
+
+  std::vector<XenoBone> bones = XenoDecodeSkeleton(skl, settings.scene);
+  printf("  %zu bones\n", bones.size());
+
+  return 0;
+}
+
+static int LoadAnimation(BC &anmFile, const char *name,
+                         const CLISettings &settings, XenoThreadPool &pool) {
+  BCANIM *anm = anmFile.GetClass<BCANIM>();
+
+  if (!anm)
+    return -1;
+
+  Stopwatch timer;
+  XenoAnimation anim = XenoBakeAnimation(
+      anm, XenoFrameGrid(anm, settings.frameRate), settings.scene, pool);
+  PrintAnimation(name, anim);
+  printf("  baked in %.2f ms\n", timer.Elapsed());
+
+  return 0;
+}
+
+static int LoadFile(const TSTRING &filename, const CLISettings &settings) {
+  TFileInfo fleInfo(filename);
+  TSTRING extension = fleInfo.GetExtension();
+
+  if (!extension.compare(_T(".arc"))) {
+    SAR arcFile;
+    int loadResult = arcFile.Load(filename.c_str(), true);
+
+    if (loadResult)
+      return loadResult;
+
+    const int ext = arcFile.FileIndexFromExtension(".skl");
+
+    if (ext < 0)
+      return ext;
+
+    BC sklFile;
+    loadResult = sklFile.Link(arcFile.GetFile(ext));
+
+    if (loadResult)
+      return loadResult;
+
+    return LoadSkeleton(sklFile, settings);
+  } else if (!extension.compare(_T(".skl"))) {
+    BC sklFile;
+    const int loadResult = sklFile.Load(filename.c_str(), true);
+
+    if (loadResult)
+      return loadResult;
+
+    return LoadSkeleton(sklFile, settings);
+  } else if (!extension.compare(_T(".mot"))) {
+    SAR arcFile;
+    const int loadResult = arcFile.Load(filename.c_str(), true);
+
+    if (loadResult)
+      return loadResult;
+
+    Stopwatch timer;
+    std::shared_ptr<const XenoMotionCatalog> catalog =
+        XenoScanMotionCatalog(filename, arcFile);
+    const int numMotions = static_cast<int>(catalog->size());
+
+    printf("  %d motions, catalog in %.2f ms\n", numMotions, timer.Elapsed());
+
+    XenoThreadPool pool(settings.scene.numThreads);
+    const std::vector<int> &indices = settings.motionIndices;
+
+    for (int m = 0; m < numMotions; m++) {
+      if (indices.size() &&
+          std::find(indices.begin(), indices.end(), m) == indices.end())
+        continue;
+
+      const XenoMotionInfo &info = catalog->at(m);
+      BC anmFile;
+
+      if (!anmFile.Link(arcFile.GetFile(info.fileID)))
+        LoadAnimation(anmFile, info.name.c_str(), settings, pool);
+    }
+
+    return 0;
+  } else if (!extension.compare(_T(".anm"))) {
+    BC anmFile;
+    const int loadResult = anmFile.Load(filename.c_str(), true);
+
+    if (loadResult)
+      return loadResult;
+
+    XenoThreadPool pool(settings.scene.numThreads);
+
+    return LoadAnimation(anmFile, fleInfo.GetFileName().c_str(), settings,
+                         pool);
+  }
+
+  return LoadMXMD(filename, settings);
+}
+
+static void PrintHelp() {
+  printf("XenoCLI [options] files...\n"
+         "  -s <scale>    scale, default 1\n"
+         "  -f <fps>      animation frame rate, default 30\n"
+         "  -m <i,j,...>  import only listed motions from .mot\n"
+         "  -j <threads>  decode threads, default 0 (all cores)\n"
+         "  -l <policy>   LODs: all (default), base or triangle budget\n"
+         "  -L <g:l>      also decode LOD level l of mesh group g\n"
+         "  -k <t,r,s>    reduce keys, translation, rotation (degrees) and "
+         "scale tolerance\n"
+         "  -t            extract textures\n"
+         "  -x <threads>  texture threads, default 0 (all cores)\n"
+         "  -c <folder>   texture cache folder\n"
+         "  --cache-size <MB>  texture cache size cap, default 2048\n"
+         "  -p            convert textures to PNG\n"
+         "  --png <profile>  PNG encoding: max (default) or fast\n"
+         "  -b            keep 2 channel normal maps\n"
+         "  --bench [filter]  run synthetic decoder benchmarks\n"
+         "  --verify <model>  check fast decoders against reference\n");
+}
+
+// Whole string has to be a number, unlike atoi.
+static bool ParseInt(const char *str, int &value) {
+  char *end;
+  const long result = strtol(str, &end, 10);
+
+  if (end == str || *end)
+    return false;
+
+  value = static_cast<int>(result);
+
+  return true;
+}
+
+static int InvalidArgument(const char *arg, const char *value) {
+  fprintf(stderr, "Invalid value for %s: %s\n", arg, value);
+
+  return 1;
+}
+
+int main(int argc, char **argv) {
+  printer.AddPrinterFunction(PrintLog);
+
+  CLISettings settings;
+  std::vector<TSTRING> files;
+
+  for (int a = 1; a < argc; a++) {
+    const char *arg = argv[a];
+
+    if (!strcmp(arg, "-s") && a + 1 < argc)
+      settings.scene.scale = static_cast<float>(atof(argv[++a]));
+    else if (!strcmp(arg, "-f") && a + 1 < argc)
+      settings.frameRate = static_cast<float>(atof(argv[++a]));
+    else if (!strcmp(arg, "-m") && a + 1 < argc) {
+      std::string indices = argv[++a];
+      size_t begin = 0;
+
+      while (begin <= indices.size()) {
+        size_t end = indices.find(',', begin);
+
+        if (end == indices.npos)
+          end = indices.size();
+
+        int index;
+
+        if (!ParseInt(indices.substr(begin, end - begin).c_str(), index) ||
+            index < 0)
+          return InvalidArgument(arg, argv[a]);
+
+        settings.motionIndices.push_back(index);
+        begin = end + 1;
+      }
+    } else if (!strcmp(arg, "-j") && a + 1 < argc) {
+      if (!ParseInt(argv[++a], settings.scene.numThreads) ||
+          settings.scene.numThreads < 0)
+        return InvalidArgument(arg, argv[a]);
+    } else if (!strcmp(arg, "-x") && a + 1 < argc) {
+      if (!ParseInt(argv[++a], settings.scene.numTextureThreads) ||
+          settings.scene.numTextureThreads < 0)
+        return InvalidArgument(arg, argv[a]);
+    } else if (!strcmp(arg, "-c") && a + 1 < argc)
+      settings.textureCache = esStringConvert<TCHAR>(argv[++a]);
+    else if (!strcmp(arg, "--cache-size") && a + 1 < argc) {
+      if (!ParseInt(argv[++a], settings.textureCacheSize) ||
+          settings.textureCacheSize < 0)
+        return InvalidArgument(arg, argv[a]);
+    } else if (!strcmp(arg, "--png") && a + 1 < argc) {
+      const char *profile = argv[++a];
+
+      if (!strcmp(profile, "fast"))
+        settings.PNGProfile = XenoPNG_Fast;
+      else if (!strcmp(profile, "max"))
+        settings.PNGProfile = XenoPNG_Max;
+      else
+        return InvalidArgument(arg, profile);
+    } else if (!strcmp(arg, "-l") && a + 1 < argc) {
+      const char *policy = argv[++a];
+
+      if (!strcmp(policy, "base"))
+        settings.scene.LODPolicy = XenoLOD_Base;
+      else if (!strcmp(policy, "all"))
+        settings.scene.LODPolicy = XenoLOD_All;
+      else if (ParseInt(policy, settings.scene.LODBudget) &&
+               settings.scene.LODBudget > 0)
+        settings.scene.LODPolicy = XenoLOD_Budget;
+      else
+        return InvalidArgument(arg, policy);
+    } else if (!strcmp(arg, "-L") && a + 1 < argc) {
+      std::string level = argv[++a];
+      const size_t colon = level.find(':');
+      int group, LOD;
+
+      if (colon == level.npos ||
+          !ParseInt(level.substr(0, colon).c_str(), group) ||
+          !ParseInt(level.substr(colon + 1).c_str(), LOD) || LOD < 1)
+        return InvalidArgument(arg, argv[a]);
+
+      settings.extraLODs.emplace_back(group, LOD);
+    } else if (!strcmp(arg, "-k") && a + 1 < argc) {
+      XenoSettings &scene = settings.scene;
+      scene.reduceKeys = true;
+
+      if (sscanf(argv[++a], "%f,%f,%f", &scene.positionTolerance,
+                 &scene.rotationTolerance, &scene.scaleTolerance) != 3)
+        return InvalidArgument(arg, argv[a]);
+    } else if (!strcmp(arg, "-t"))
+      settings.textures = true;
+    else if (!strcmp(arg, "-p"))
+      settings.toPNG = true;
+    else if (!strcmp(arg, "-b"))
+      settings.BC5BChan = true;
+    else if (!strcmp(arg, "--bench"))
+      return XenoRunBenchmarks(a + 1 < argc ? argv[a + 1] : nullptr);
+    else if (!strcmp(arg, "--verify") && a + 1 < argc)
+      return XenoVerifyModel(esStringConvert<TCHAR>(argv[a + 1]));
+    else if (!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+      PrintHelp();
+      return 0;
+    } else if (arg[0] == '-') {
+      fprintf(stderr, "Unknown option or missing value: %s\n", arg);
+      return 1;
+    } else
+      files.push_back(esStringConvert<TCHAR>(arg));
+  }
+
+  if (!files.size()) {
+    PrintHelp();
+    return 1;
+  }
+
+  int result = 0;
+
+  for (auto &f : files) {
+    printf("%s\n", f.c_str());
+    Stopwatch timer;
+    const int loadResult = LoadFile(f, settings);
+
+    if (loadResult) {
+      printf("  failed with code %d\n", loadResult);
+      result = 1;
+    } else
+      printf("  done in %.2f ms\n", timer.Elapsed());
+  }
+
+  return result;
+}
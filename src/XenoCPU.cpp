@@ -0,0 +1,51 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "XenoCPU.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+
+static bool HasFeature(int leaf, int reg, int bit) {
+  int info[4];
+  __cpuid(info, 0);
+
+  if (info[0] < leaf)
+    return false;
+
+  __cpuidex(info, leaf, 0);
+
+  return (info[reg] >> bit) & 1;
+}
+
+bool XenoCPUHasSSSE3() { return HasFeature(1, 2, 9); }
+
+bool XenoCPUHasAVX2() {
+  // OS has to save YMM registers too
+  return HasFeature(1, 2, 27) && (_xgetbv(0) & 6) == 6 &&
+         HasFeature(7, 1, 5);
+}
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+bool XenoCPUHasSSSE3() { return __builtin_cpu_supports("ssse3"); }
+
+bool XenoCPUHasAVX2() { return __builtin_cpu_supports("avx2"); }
+#else
+bool XenoCPUHasSSSE3() { return false; }
+
+bool XenoCPUHasAVX2() { return false; }
+#endif
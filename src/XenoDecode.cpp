@@ -0,0 +1,551 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "XenoDecode.h"
+#include "XenoCPU.h"
+#include "XenoScene.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(__AVX2__)
+#define XENO_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || _M_IX86_FP >= 2
+#define XENO_SSE
+#include <emmintrin.h>
+#endif
+
+void XenoTransformPositions(Vector *data, int count, float scale) {
+  float *fData = reinterpret_cast<float *>(data);
+  int v = 0;
+
+#ifdef XENO_AVX2
+  // 8 vertices per iteration, within every triplet Y and Z are swapped,
+  // only pair crossing first and second register needs extra blend.
+  const __m256i permA = _mm256_setr_epi32(0, 2, 1, 3, 5, 4, 6, 7);
+  const __m256i permB = _mm256_setr_epi32(0, 1, 3, 2, 4, 6, 5, 7);
+  const __m256i permC = _mm256_setr_epi32(1, 0, 2, 4, 3, 5, 7, 6);
+  const __m256i lane0 = _mm256_set1_epi32(0);
+  const __m256i lane7 = _mm256_set1_epi32(7);
+  const __m256 scaleA = _mm256_setr_ps(scale, -scale, scale, scale, -scale,
+                                       scale, scale, -scale);
+  const __m256 scaleB = _mm256_setr_ps(scale, scale, -scale, scale, scale,
+                                       -scale, scale, scale);
+  const __m256 scaleC = _mm256_setr_ps(-scale, scale, scale, -scale, scale,
+                                       scale, -scale, scale);
+
+  for (; v + 8 <= count; v += 8, fData += 24) {
+    const __m256 a = _mm256_loadu_ps(fData);
+    const __m256 b = _mm256_loadu_ps(fData + 8);
+    const __m256 c = _mm256_loadu_ps(fData + 16);
+
+    __m256 outA = _mm256_permutevar8x32_ps(a, permA);
+    __m256 outB = _mm256_permutevar8x32_ps(b, permB);
+    const __m256 outC = _mm256_permutevar8x32_ps(c, permC);
+    outA = _mm256_blend_ps(outA, _mm256_permutevar8x32_ps(b, lane0), 0x80);
+    outB = _mm256_blend_ps(outB, _mm256_permutevar8x32_ps(a, lane7), 0x01);
+
+    _mm256_storeu_ps(fData, _mm256_mul_ps(outA, scaleA));
+    _mm256_storeu_ps(fData + 8, _mm256_mul_ps(outB, scaleB));
+    _mm256_storeu_ps(fData + 16, _mm256_mul_ps(outC, scaleC));
+  }
+#endif
+
+#ifdef XENO_SSE
+  // 4 vertices per iteration, 3 registers:
+  // [x0 y0 z0 x1] [y1 z1 x2 y2] [z2 x3 y3 z3]
+  // becomes (x, -z, y) * scale:
+  // [x0 -z0 y0 x1] [-z1 y1 x2 -z2] [y2 x3 -z3 y3]
+  const __m128 scale0 = _mm_setr_ps(scale, -scale, scale, scale);
+  const __m128 scale1 = _mm_setr_ps(-scale, scale, scale, -scale);
+  const __m128 scale2 = _mm_setr_ps(scale, scale, -scale, scale);
+
+  for (; v + 4 <= count; v += 4, fData += 12) {
+    const __m128 a = _mm_loadu_ps(fData);
+    const __m128 b = _mm_loadu_ps(fData + 4);
+    const __m128 c = _mm_loadu_ps(fData + 8);
+
+    const __m128 out0 = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 2, 0));
+    const __m128 b2c0 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(0, 0, 2, 2));
+    const __m128 out1 = _mm_shuffle_ps(b, b2c0, _MM_SHUFFLE(2, 0, 0, 1));
+    const __m128 b3c1 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 3, 3));
+    const __m128 out2 = _mm_shuffle_ps(b3c1, c, _MM_SHUFFLE(2, 3, 2, 0));
+
+    _mm_storeu_ps(fData, _mm_mul_ps(out0, scale0));
+    _mm_storeu_ps(fData + 4, _mm_mul_ps(out1, scale1));
+    _mm_storeu_ps(fData + 8, _mm_mul_ps(out2, scale2));
+  }
+#endif
+
+  for (; v < count; v++)
+    data[v] = XenoCorrectAxis(data[v] * scale);
+}
+
+void XenoDecodePositions(MXMDVertexDescriptor *d, int begin, int count,
+                         Vector *out, float scale) {
+  XenoDecodeAttribute(d, XenoSelectDecoder(d, XenoAttr_Position), begin,
+                      count, out);
+  XenoTransformPositions(out, count, scale);
+}
+
+XenoStream XenoGetStream(MXMDVertexDescriptor *d) {
+  return {d->buffer, d->stride, d->Size()};
+}
+
+static Vector NormalizeNormal(const Vector &in) {
+  const float length = sqrtf(in.X * in.X + in.Y * in.Y + in.Z * in.Z);
+
+  if (length <= 0.f)
+    return in;
+
+  return in * (1.f / length);
+}
+
+static Vector UnpackNormal(const char *data, XenoNormalFormat format) {
+  switch (format) {
+  case XenoNormal_SNORM8: {
+    const signed char *comps = reinterpret_cast<const signed char *>(data);
+    return Vector(std::max(comps[0] / 127.f, -1.f),
+                  std::max(comps[1] / 127.f, -1.f),
+                  std::max(comps[2] / 127.f, -1.f));
+  }
+  default: {
+    Vector retval;
+    memcpy(&retval, data, sizeof(retval));
+    return retval;
+  }
+  }
+}
+
+#ifdef XENO_SSE
+static __m128i LoadU32(const char *data) {
+  int value;
+  memcpy(&value, data, sizeof(value));
+  return _mm_cvtsi32_si128(value);
+}
+
+// 4 strided 32 bit items, single 16 byte load when they are packed.
+static __m128i GatherU32(const char *data, int stride) {
+  if (stride == 4)
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+
+  const __m128i low = _mm_unpacklo_epi32(LoadU32(data), LoadU32(data + stride));
+  const __m128i high = _mm_unpacklo_epi32(LoadU32(data + stride * 2),
+                                          LoadU32(data + stride * 3));
+
+  return _mm_unpacklo_epi64(low, high);
+}
+
+template <int shift, int numBits>
+static __m128 UnpackSigned(__m128i value, __m128 mult) {
+  const __m128i extended = _mm_srai_epi32(
+      _mm_slli_epi32(value, 32 - shift - numBits), 32 - numBits);
+  return _mm_max_ps(_mm_mul_ps(_mm_cvtepi32_ps(extended), mult),
+                    _mm_set1_ps(-1.f));
+}
+
+// Normalizes 4 SoA normals, converts them into Z up space and stores them
+// interleaved.
+static void StoreNormals(__m128 x, __m128 y, __m128 z, float *out) {
+  const __m128 lengthSq = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+  const __m128 zeroMask = _mm_cmpgt_ps(lengthSq, _mm_setzero_ps());
+  // rsqrt estimate refined by single Newton-Raphson step
+  const __m128 estimate = _mm_rsqrt_ps(lengthSq);
+  const __m128 refined = _mm_mul_ps(
+      _mm_mul_ps(_mm_set1_ps(0.5f), estimate),
+      _mm_sub_ps(_mm_set1_ps(3.f),
+                 _mm_mul_ps(_mm_mul_ps(lengthSq, estimate), estimate)));
+  const __m128 invLength =
+      _mm_or_ps(_mm_and_ps(zeroMask, refined),
+                _mm_andnot_ps(zeroMask, _mm_set1_ps(1.f)));
+
+  const __m128 X = _mm_mul_ps(x, invLength);
+  const __m128 Y = _mm_mul_ps(z, _mm_sub_ps(_mm_setzero_ps(), invLength));
+  const __m128 Z = _mm_mul_ps(y, invLength);
+
+  const __m128 xyLow = _mm_unpacklo_ps(X, Y);
+  const __m128 xyHigh = _mm_unpackhi_ps(X, Y);
+  const __m128 z0x1 = _mm_shuffle_ps(Z, X, _MM_SHUFFLE(1, 1, 0, 0));
+  const __m128 y1z1 = _mm_shuffle_ps(Y, Z, _MM_SHUFFLE(1, 1, 1, 1));
+  const __m128 z2x3 = _mm_shuffle_ps(Z, xyHigh, _MM_SHUFFLE(2, 2, 2, 2));
+  const __m128 y3z3 = _mm_shuffle_ps(xyHigh, Z, _MM_SHUFFLE(3, 3, 3, 3));
+
+  _mm_storeu_ps(out, _mm_shuffle_ps(xyLow, z0x1, _MM_SHUFFLE(2, 0, 1, 0)));
+  _mm_storeu_ps(out + 4, _mm_shuffle_ps(y1z1, xyHigh, _MM_SHUFFLE(1, 0, 2, 0)));
+  _mm_storeu_ps(out + 8, _mm_shuffle_ps(z2x3, y3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+#endif
+
+void XenoUnpackNormals(const XenoStream &stream, XenoNormalFormat format,
+                       Vector *out) {
+  const char *data = stream.data;
+  int v = 0;
+
+#ifdef XENO_SSE
+  float *fOut = reinterpret_cast<float *>(out);
+
+  switch (format) {
+  case XenoNormal_SNORM8: {
+    const __m128 mult = _mm_set1_ps(1.f / 127.f);
+
+    for (; v + 4 <= stream.count; v += 4, data += stream.stride * 4) {
+      const __m128i value = GatherU32(data, stream.stride);
+      StoreNormals(UnpackSigned<0, 8>(value, mult),
+                   UnpackSigned<8, 8>(value, mult),
+                   UnpackSigned<16, 8>(value, mult), fOut + v * 3);
+    }
+    break;
+  }
+  default: {
+    for (; v + 4 <= stream.count; v += 4, data += stream.stride * 4) {
+      float verts[4][3];
+
+      for (int i = 0; i < 4; i++)
+        memcpy(verts[i], data + stream.stride * i, sizeof(verts[i]));
+
+      StoreNormals(
+          _mm_setr_ps(verts[0][0], verts[1][0], verts[2][0], verts[3][0]),
+          _mm_setr_ps(verts[0][1], verts[1][1], verts[2][1], verts[3][1]),
+          _mm_setr_ps(verts[0][2], verts[1][2], verts[2][2], verts[3][2]),
+          fOut + v * 3);
+    }
+    break;
+  }
+  }
+#endif
+
+  for (; v < stream.count; v++, data += stream.stride)
+    out[v] = XenoCorrectAxis(NormalizeNormal(UnpackNormal(data, format)));
+}
+
+void XenoTransformNormals(Vector *data, int count) {
+  // Every block is fully read before it's written, safe in place.
+  XenoStream stream{reinterpret_cast<const char *>(data), sizeof(Vector),
+                    count};
+  XenoUnpackNormals(stream, XenoNormal_Float, data);
+}
+
+bool XenoGetNormalFormat(MXMDVertexDescriptor *d, XenoNormalFormat &format) {
+  switch (d->Type()) {
+  case MXMD_NORMAL:
+  case MXMD_NORMAL2:
+    format = XenoNormal_SNORM8;
+    return true;
+  case MXMD_NORMAL32:
+    format = XenoNormal_Float;
+    return true;
+  default:
+    return false;
+  }
+}
+
+void XenoDecodeNormals(MXMDVertexDescriptor *d, int count, Vector *out) {
+  static const int formatSizes[] = {4, 12};
+  XenoStream stream = XenoGetStream(d);
+  XenoNormalFormat format;
+
+  if (stream.data && stream.count >= count && XenoGetNormalFormat(d, format) &&
+      stream.stride >= formatSizes[format]) {
+    stream.count = count;
+    XenoUnpackNormals(stream, format, out);
+    return;
+  }
+
+  for (int v = 0; v < count; v++) {
+    Vector4 temp;
+    d->Evaluate(v, &temp);
+    out[v] = Vector(temp.X, temp.Y, temp.Z);
+  }
+
+  XenoTransformNormals(out, count);
+}
+
+// Storage formats, Read returns value in same layout as Evaluate does.
+
+struct StorageFloat2 {
+  typedef Vector2 type;
+  static const int size = 8;
+  static type Read(const char *data) {
+    type retval;
+    memcpy(&retval.X, data, size);
+    return retval;
+  }
+};
+
+struct StorageFloat3 {
+  typedef Vector type;
+  static const int size = 12;
+  static type Read(const char *data) {
+    type retval;
+    memcpy(&retval.X, data, size);
+    return retval;
+  }
+};
+
+struct StorageUNORM8x4 {
+  typedef Vector4 type;
+  static const int size = 4;
+  static type Read(const char *data) {
+    const uchar *comps = reinterpret_cast<const uchar *>(data);
+    const float mult = 1.f / 255.f;
+    return Vector4(comps[0] * mult, comps[1] * mult, comps[2] * mult,
+                   comps[3] * mult);
+  }
+};
+
+struct StorageUShort {
+  typedef ushort type;
+  static const int size = 2;
+  static type Read(const char *data) {
+    type retval;
+    memcpy(&retval, data, size);
+    return retval;
+  }
+};
+
+struct StorageInt {
+  typedef int type;
+  static const int size = 4;
+  static type Read(const char *data) {
+    type retval;
+    memcpy(&retval, data, size);
+    return retval;
+  }
+};
+
+// Attributes, Convert turns Evaluate layout into final output.
+
+struct AttributePosition {
+  typedef Vector reference;
+  typedef Vector type;
+  static type Convert(const reference &in) { return in; }
+};
+
+struct AttributeUV {
+  typedef Vector2 reference;
+  typedef Vector type;
+  static type Convert(const reference &in) {
+    return Vector(in.X, 1.f - in.Y, 0.f);
+  }
+};
+
+struct AttributeColor {
+  typedef Vector4 reference;
+  typedef Vector4 type;
+  static type Convert(const reference &in) { return in; }
+};
+
+struct AttributeWeightID {
+  typedef ushort reference;
+  typedef ushort type;
+  static type Convert(const reference &in) { return in; }
+};
+
+struct AttributeMorphID {
+  typedef int reference;
+  typedef int type;
+  static type Convert(const reference &in) { return in; }
+};
+
+template <class Attribute, class Storage, int stride>
+static void DecodeStream(const XenoStream &stream, void *outData) {
+  typedef typename Attribute::type out_type;
+  out_type *out = static_cast<out_type *>(outData);
+  const int cStride = stride ? stride : stream.stride;
+  const char *data = stream.data;
+
+  for (int v = 0; v < stream.count; v++, data += cStride)
+    out[v] = Attribute::Convert(Storage::Read(data));
+}
+
+template <class Attribute>
+static void EvaluateStream(MXMDVertexDescriptor *d, int begin, int count,
+                           void *outData) {
+  typedef typename Attribute::type out_type;
+  out_type *out = static_cast<out_type *>(outData);
+
+  for (int v = 0; v < count; v++) {
+    typename Attribute::reference temp;
+    d->Evaluate(begin + v, &temp);
+    out[v] = Attribute::Convert(temp);
+  }
+}
+
+// Strides up to 64 bytes in 4 byte steps are compile time constants,
+// anything else uses runtime stride.
+static const int numFixedStrides = 17;
+
+template <class Attribute, class Storage, int... strides>
+static XenoDecodeFunc PickStride(int stride,
+                                 std::integer_sequence<int, strides...>) {
+  static const XenoDecodeFunc funcs[] = {
+      DecodeStream<Attribute, Storage, strides * 4>...};
+
+  if (!(stride % 4) && stride / 4 < numFixedStrides)
+    return funcs[stride / 4];
+
+  return DecodeStream<Attribute, Storage, 0>;
+}
+
+template <class Attribute, class Storage>
+static XenoDecodeFunc PickStride(int stride) {
+  if (stride < Storage::size)
+    return nullptr;
+
+  return PickStride<Attribute, Storage>(
+      stride, std::make_integer_sequence<int, numFixedStrides>{});
+}
+
+XenoDecodeFunc XenoGetDecoder(XenoAttribute attribute, XenoVertexFormat format,
+                              int stride) {
+  switch (attribute) {
+  case XenoAttr_Position:
+    if (format == XenoFormat_Float3)
+      return PickStride<AttributePosition, StorageFloat3>(stride);
+    break;
+  case XenoAttr_UV:
+    if (format == XenoFormat_Float2)
+      return PickStride<AttributeUV, StorageFloat2>(stride);
+    break;
+  case XenoAttr_Color:
+    if (format == XenoFormat_UNORM8x4)
+      return PickStride<AttributeColor, StorageUNORM8x4>(stride);
+    break;
+  case XenoAttr_WeightID:
+    if (format == XenoFormat_UShort)
+      return PickStride<AttributeWeightID, StorageUShort>(stride);
+    break;
+  case XenoAttr_MorphID:
+    if (format == XenoFormat_Int)
+      return PickStride<AttributeMorphID, StorageInt>(stride);
+    break;
+  }
+
+  return nullptr;
+}
+
+XenoVertexFormat XenoGetVertexFormat(MXMDVertexDescriptor *d) {
+  switch (d->Type()) {
+  case MXMD_POSITION:
+    return XenoFormat_Float3;
+  case MXMD_UV1:
+  case MXMD_UV2:
+  case MXMD_UV3:
+    return XenoFormat_Float2;
+  case MXMD_VERTEXCOLOR:
+    return XenoFormat_UNORM8x4;
+  case MXMD_WEIGHTID:
+    return XenoFormat_UShort;
+  case MXMD_MORPHVERTEXID:
+    return XenoFormat_Int;
+  default:
+    return XenoFormat_Evaluate;
+  }
+}
+
+template <class Attribute>
+static XenoAttributeDecoder SelectDecoder(MXMDVertexDescriptor *d,
+                                          XenoAttribute attribute) {
+  XenoAttributeDecoder retval{attribute, XenoFormat_Evaluate, nullptr,
+                              EvaluateStream<Attribute>};
+  const XenoStream stream = XenoGetStream(d);
+
+  if (!stream.data)
+    return retval;
+
+  const XenoVertexFormat format = XenoGetVertexFormat(d);
+  XenoDecodeFunc func = XenoGetDecoder(attribute, format, stream.stride);
+
+  if (func) {
+    retval.format = format;
+    retval.decode = func;
+  }
+
+  return retval;
+}
+
+XenoAttributeDecoder XenoSelectDecoder(MXMDVertexDescriptor *d,
+                                       XenoAttribute attribute) {
+  switch (attribute) {
+  case XenoAttr_Position:
+    return SelectDecoder<AttributePosition>(d, attribute);
+  case XenoAttr_UV:
+    return SelectDecoder<AttributeUV>(d, attribute);
+  case XenoAttr_Color:
+    return SelectDecoder<AttributeColor>(d, attribute);
+  case XenoAttr_WeightID:
+    return SelectDecoder<AttributeWeightID>(d, attribute);
+  case XenoAttr_MorphID:
+  default:
+    return SelectDecoder<AttributeMorphID>(d, XenoAttr_MorphID);
+  }
+}
+
+void XenoDecodeAttribute(MXMDVertexDescriptor *d,
+                         const XenoAttributeDecoder &decoder, int begin,
+                         int count, void *out) {
+  if (!decoder.decode) {
+    decoder.evaluate(d, begin, count, out);
+    return;
+  }
+
+  XenoStream stream = XenoGetStream(d);
+  stream.data += static_cast<size_t>(begin) * stream.stride;
+  stream.count = count;
+  decoder.decode(stream, out);
+}
+
+void XenoRemapMorphDeltas(const int *IDS, const Vector *deltas, int count,
+                          const int *remap, int numVerts,
+                          std::vector<int> &outIndices,
+                          std::vector<Vector> &outDeltas) {
+  outIndices.reserve(outIndices.size() + count);
+  outDeltas.reserve(outDeltas.size() + count);
+
+  for (int i = 0; i < count; i++) {
+    const uint vertexID = IDS[i];
+
+    if (vertexID >= static_cast<uint>(numVerts) || remap[vertexID] < 0)
+      continue;
+
+    const Vector &delta = deltas[i];
+
+    if (delta.X == 0.f && delta.Y == 0.f && delta.Z == 0.f)
+      continue;
+
+    outIndices.push_back(remap[vertexID]);
+    outDeltas.push_back(delta);
+  }
+}
+
+void XenoGatherIndices(const int *table, const ushort *indices, int count,
+                       int *out) {
+  static const bool useAVX2 = XenoCPUHasAVX2();
+
+  if (useAVX2) {
+    XenoGatherIndicesAVX2(table, indices, count, out);
+    return;
+  }
+
+  for (int i = 0; i < count; i++)
+    out[i] = table[indices[i]];
+}
@@ -0,0 +1,125 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Bulk vertex attribute decoders, whole ranges at once.
+
+#pragma once
+#include "MXMD.h"
+#include <vector>
+
+// Raw view of descriptor data.
+struct XenoStream {
+  const char *data;
+  int stride;
+  int count;
+};
+
+XenoStream XenoGetStream(MXMDVertexDescriptor *d);
+
+enum XenoNormalFormat {
+  XenoNormal_SNORM8, // 4x signed byte, last unused
+  XenoNormal_Float,  // 3x float
+};
+
+enum XenoAttribute {
+  XenoAttr_Position, // Vector
+  XenoAttr_UV,       // Vector, flipped map vertex
+  XenoAttr_Color,    // Vector4
+  XenoAttr_WeightID, // ushort
+  XenoAttr_MorphID,  // int
+};
+
+enum XenoVertexFormat {
+  XenoFormat_Float2,
+  XenoFormat_Float3,
+  XenoFormat_UNORM8x4,
+  XenoFormat_UShort,
+  XenoFormat_Int,
+  XenoFormat_Evaluate, // per element Evaluate, fallback
+};
+
+typedef void (*XenoDecodeFunc)(const XenoStream &stream, void *out);
+typedef void (*XenoEvaluateFunc)(MXMDVertexDescriptor *d, int begin,
+                                 int count, void *out);
+
+// Decoder specialized for attribute, storage format and stride.
+// Selected once per descriptor, then streams whole ranges.
+struct XenoAttributeDecoder {
+  XenoAttribute attribute;
+  XenoVertexFormat format;
+  XenoDecodeFunc decode;
+  XenoEvaluateFunc evaluate;
+};
+
+// Specialized decode loop, nullptr if combination doesn't exist.
+XenoDecodeFunc XenoGetDecoder(XenoAttribute attribute, XenoVertexFormat format,
+                              int stride);
+
+// Storage format XenoLib uses for descriptor type, XenoFormat_Evaluate for
+// types without specialized decoder.
+XenoVertexFormat XenoGetVertexFormat(MXMDVertexDescriptor *d);
+
+// Picks decoder by descriptor type and stride, Evaluate when format doesn't
+// fit attribute or stride.
+XenoAttributeDecoder XenoSelectDecoder(MXMDVertexDescriptor *d,
+                                       XenoAttribute attribute);
+
+// Decodes [begin, begin + count) range of descriptor into out, out type
+// depends on attribute.
+void XenoDecodeAttribute(MXMDVertexDescriptor *d,
+                         const XenoAttributeDecoder &decoder, int begin,
+                         int count, void *out);
+
+// Scales and converts into Z up space contiguous float3 array, in place.
+void XenoTransformPositions(Vector *data, int count, float scale);
+
+// Decodes [begin, begin + count) range of descriptor into out.
+void XenoDecodePositions(MXMDVertexDescriptor *d, int begin, int count,
+                         Vector *out, float scale);
+
+// Unpacks packed normals, renormalizes them and converts into Z up space.
+void XenoUnpackNormals(const XenoStream &stream, XenoNormalFormat format,
+                       Vector *out);
+
+// Renormalizes and converts into Z up space contiguous float3 array, in
+// place.
+void XenoTransformNormals(Vector *data, int count);
+
+// Packing XenoLib uses for descriptor type, false for types without
+// specialized unpacker.
+bool XenoGetNormalFormat(MXMDVertexDescriptor *d, XenoNormalFormat &format);
+
+// Decodes all normals of descriptor into out.
+// Packing follows descriptor type, unknown types or strides fall back to per
+// vertex Evaluate.
+void XenoDecodeNormals(MXMDVertexDescriptor *d, int count, Vector *out);
+
+// Keeps non zero morph deltas of vertices referenced by faces and remaps
+// their indices. remap is vertex to compacted vertex, -1 for isolated ones.
+// Runs in O(deltas), duplicate ids keep their order.
+void XenoRemapMorphDeltas(const int *IDS, const Vector *deltas, int count,
+                          const int *remap, int numVerts,
+                          std::vector<int> &outIndices,
+                          std::vector<Vector> &outDeltas);
+
+// out[i] = table[indices[i]], indices must be within table.
+// Vectorized when CPU supports AVX2.
+void XenoGatherIndices(const int *table, const ushort *indices, int count,
+                       int *out);
+// AVX2 gather, caller checks CPU support. Scalar on non x86 builds.
+void XenoGatherIndicesAVX2(const int *table, const ushort *indices, int count,
+                           int *out);
@@ -0,0 +1,42 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Built with AVX2 enabled, only called when CPU reports it.
+
+#include "XenoDecode.h"
+
+#if defined(__AVX2__) || defined(_M_X64) || defined(_M_IX86)
+#define XENO_AVX2
+#include <immintrin.h>
+#endif
+
+void XenoGatherIndicesAVX2(const int *table, const ushort *indices, int count,
+                           int *out) {
+  int i = 0;
+
+#ifdef XENO_AVX2
+  for (; i + 8 <= count; i += 8) {
+    const __m256i ids = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(indices + i)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                        _mm256_i32gather_epi32(table, ids, 4));
+  }
+#endif
+
+  for (; i < count; i++)
+    out[i] = table[indices[i]];
+}
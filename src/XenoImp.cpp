@@ -15,13 +15,15 @@
         along with this program.If not, see <https://www.gnu.org/licenses/>.
 */
 
-#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <IPathConfigMgr.h>
 #include <MeshNormalSpec.h>
 #include <ilayer.h>
 #include <ilayermanager.h>
 #include <iskin.h>
+#include <notetrck.h>
 #include <stdmat.h>
 #include <triobj.h>
 
@@ -33,6 +35,9 @@
 #include "SAR.h"
 #include "XenoImport.h"
 #include "XenoMax.h"
+#include "XenoScene.h"
+#include "XenoTexCache.h"
+#include "XenoThreads.h"
 
 #include "MAXex/NodeSuffix.h"
 #include "datas/esstring.h"
@@ -43,6 +48,81 @@
 #define HavokImport_CLASS_ID Class_ID(0xad115395, 0x924c02c0)
 static const TCHAR _className[] = _T("XenoImp");
 
+static TSTRING ToKey(const TCHAR *name) {
+  TSTRING key = name;
+
+  for (auto &c : key)
+    c = _totlower(c);
+
+  return key;
+}
+
+// Node name to node index, built by single scene walk on first lookup and
+// kept for whole import. Nodes created meanwhile have to be added.
+// Names are case insensitive, same as GetINodeByName.
+class NodeNameIndex : public ITreeEnumProc {
+  std::unordered_map<TSTRING, INode *> nodes;
+  bool valid = false;
+
+public:
+  INode *LookupNode(const TSTRING &name) {
+    if (!valid) {
+      GetCOREInterface7()->GetScene()->EnumTree(this);
+      valid = true;
+    }
+
+    auto found = nodes.find(ToKey(name.c_str()));
+
+    return found != nodes.end() ? found->second : nullptr;
+  }
+
+  void AddNode(INode *node) {
+    if (valid)
+      nodes.emplace(ToKey(node->GetName()), node);
+  }
+
+  int callback(INode *node) {
+    nodes.emplace(ToKey(node->GetName()), node);
+
+    return TREE_CONTINUE;
+  }
+};
+
+// PNG files of folders, listed once per folder on first lookup.
+// Used instead of probing every texture, which is slow on network shares.
+class PNGFileIndex {
+  std::unordered_map<TSTRING, std::unordered_set<TSTRING>> folders;
+
+public:
+  // path is without extension
+  bool Contains(const TSTRING &path) {
+    const size_t split = path.find_last_of(_T("/\\")) + 1;
+    const TSTRING folder = path.substr(0, split);
+    auto found = folders.find(folder);
+
+    if (found == folders.end()) {
+      found = folders.emplace(folder, std::unordered_set<TSTRING>()).first;
+      WIN32_FIND_DATA findData;
+      HANDLE handle = FindFirstFile((folder + _T("*.png")).c_str(), &findData);
+
+      if (handle != INVALID_HANDLE_VALUE) {
+        do
+          found->second.insert(ToKey(findData.cFileName));
+        while (FindNextFile(handle, &findData));
+
+        FindClose(handle);
+      }
+    }
+
+    const TSTRING fileName = path.substr(split) + _T(".png");
+
+    return found->second.count(ToKey(fileName.c_str())) > 0;
+  }
+};
+
+// Local transforms of bones, world for children of scene root.
+typedef std::unordered_map<INode *, Matrix3> XenoRestPose;
+
 class XenoImp : public SceneImport, XenoImport {
 public:
   // Constructor/Destructor
@@ -67,21 +147,24 @@ public:
   std::vector<INode *> remapNodes;
   std::vector<StdMat *> outMats;
   std::vector<BitmapTex *> texmaps;
+  XenoMeshCache meshCache;
+  NodeNameIndex nodeNames;
+  XenoTextureQueue texQueue;
+  int numPendingTextures = 0;
 
+  XenoSettings GetSettings() const;
   void LoadSkeleton(BCSKEL *skel);
-  void LoadAnimation(BCANIM *anim);
+  int LoadAnimation(BCANIM *anim, XenoThreadPool &pool, int startFrame = 0,
+                    const XenoRestPose *restPose = nullptr);
   void LoadModels(MXMD *model);
-  INodeTab LoadMeshes(MXMD *model, MXMDModel::Ptr &mdl, int curGroup);
+  INodeTab LoadMeshes(std::vector<XenoMesh> &meshes, int curGroup);
   int LoadTextures(MXMD *model);
+  void HookupTextures(bool wait);
   void LoadMaterials(MXMD *model);
   int LoadInstances(MXMD *model);
   void LoadModelPose(MXMDModel::Ptr &model);
-  void ApplySkin(MXMDGeomBuffers::Ptr &buff, MXMDMeshObject::Ptr &mesh,
-                 INodeSuffixer &nde, Face *mfac,
-                 MXMDVertexDescriptor *skinDesc);
-  void ApplyMorph(MXMDMorphTargets::Ptr &morphs, INode *node, Mesh *mesh,
-                  MXMDMeshObject::Ptr &msh, MXMDModel::Ptr &mdl,
-                  MXMDGeomBuffers::Ptr &buff);
+  void ApplySkin(XenoMesh &mesh, INodeSuffixer &nde);
+  void ApplyMorph(XenoMesh &mesh, INode *node);
 
   int LoadARC(const TCHAR *name, BOOL suppressPrompts, bool subLoad = false);
   int LoadSKL(const TCHAR *name, BOOL suppressPrompts, bool subLoad = false);
@@ -151,15 +234,121 @@ unsigned int XenoImp::Version() { return XENOMAX_VERSIONINT; }
 
 void XenoImp::ShowAbout(HWND hWnd) { ShowAboutDLG(hWnd); }
 
-void XenoImp::LoadSkeleton(BCSKEL *skel) {
-  BCSKEL::BoneData *boneData = skel->boneData.ptr;
+static Matrix3 ToMatrix3(const XenoMatrix &mtx) {
+  Matrix3 retval = {};
+
+  for (int r = 0; r < 4; r++)
+    retval.SetRow(r, reinterpret_cast<const Point3 &>(mtx.r[r]));
+
+  return retval;
+}
+
+static Matrix3 ToMatrix3(const XenoTransform &tm) {
+  Matrix3 retval;
+  retval.SetRotate(reinterpret_cast<const Quat &>(tm.rotation).Conjugate());
+  retval.SetTrans(reinterpret_cast<const Point3 &>(tm.position));
+  retval.Scale(reinterpret_cast<const Point3 &>(tm.scale));
+
+  return retval;
+}
+
+XenoSettings XenoImp::GetSettings() const {
+  XenoSettings settings;
+  settings.scale = IDC_EDIT_SCALE_value;
+  settings.LODPolicy = static_cast<XenoLODPolicy>(IDC_CB_LODPOLICY_index);
+  settings.LODBudget = static_cast<int>(IDC_EDIT_LODBUDGET_value);
+  settings.numTextureThreads = static_cast<int>(IDC_EDIT_TEXTHREADS_value);
+  // Reduction runs on track values, these are in world space with global
+  // frames, error bounds wouldn't hold for solved locals
+  settings.reduceKeys = flags[IDC_CH_REDUCEKEYS_checked] &&
+                        !flags[IDC_CH_GLOBAL_FRAMES_checked];
+  settings.positionTolerance = IDC_EDIT_POSTOLERANCE_value;
+  settings.rotationTolerance = IDC_EDIT_ROTTOLERANCE_value;
+  settings.scaleTolerance = IDC_EDIT_SCLTOLERANCE_value;
+
+  return settings;
+}
+
+// Keeps XenoBone id to node index, built by single scene walk and dropped
+// on any scene change, so subsequent imports skip scanning entirely.
+static class BoneScanner : public ITreeEnumProc {
+  const MSTR boneNameHint = _T("XenoBone");
+  std::unordered_map<int, INode *> bones;
+  bool valid = false;
+  bool registered = false;
+
+  static constexpr int sceneEvents[] = {
+      NOTIFY_SCENE_ADDED_NODE,  NOTIFY_SCENE_PRE_DELETED_NODE,
+      NOTIFY_SYSTEM_POST_RESET, NOTIFY_SYSTEM_POST_NEW,
+      NOTIFY_FILE_POST_OPEN,    NOTIFY_SCENE_POST_UNDO,
+      NOTIFY_SCENE_POST_REDO,
+  };
+
+  static void SceneChanged(void *param, NotifyInfo *) {
+    static_cast<BoneScanner *>(param)->Invalidate();
+  }
+
+public:
+  void Invalidate() {
+    valid = false;
+    bones.clear();
+  }
+
+  void RescanBones() {
+    if (!registered) {
+      for (auto &e : sceneEvents)
+        RegisterNotification(SceneChanged, this, e);
+
+      registered = true;
+    }
+
+    if (valid)
+      return;
+
+    bones.clear();
+    GetCOREInterface7()->GetScene()->EnumTree(this);
+    valid = true;
+  }
+
+  void Release() {
+    if (registered)
+      for (auto &e : sceneEvents)
+        UnRegisterNotification(SceneChanged, this, e);
+
+    registered = false;
+    Invalidate();
+  }
+
+  INode *LookupNode(int ID) {
+    auto found = bones.find(ID);
+
+    return found != bones.end() ? found->second : nullptr;
+  }
+
+  const std::unordered_map<int, INode *> &Bones() const { return bones; }
+
+  int callback(INode *node) {
+    if (node->UserPropExists(boneNameHint)) {
+      int ID;
+      node->GetUserPropInt(boneNameHint, ID);
+      bones.emplace(ID, node);
+    }
+
+    return TREE_CONTINUE;
+  }
+} iBoneScanner;
 
+constexpr int BoneScanner::sceneEvents[];
+
+void ReleaseBoneScanner() { iBoneScanner.Release(); }
+
+void XenoImp::LoadSkeleton(BCSKEL *skel) {
+  std::vector<XenoBone> bones = XenoDecodeSkeleton(skel, GetSettings());
   std::vector<INode *> nodes;
 
-  for (int b = 0; b < boneData->boneLinks.count; b++) {
-    const char *_boneName = boneData->boneNames.data[b].name;
-    TSTRING boneName = esString(_boneName);
-    INode *node = GetCOREInterface()->GetINodeByName(boneName.c_str());
+  for (auto &b : bones) {
+    TSTRING boneName = esStringConvert<TCHAR>(b.name.c_str());
+    INode *node = nodeNames.LookupNode(boneName);
 
     if (!node) {
       Object *obj = static_cast<Object *>(
@@ -169,136 +358,266 @@ void XenoImp::LoadSkeleton(BCSKEL *skel) {
       node->SetWireColor(0x80ff);
     }
 
-    BCSKEL::BoneTransform &boneTM = boneData->boneTransforms.data[b];
     Matrix3 nodeTM = {};
-    nodeTM.SetRotate(
-        reinterpret_cast<const Quat &>(boneTM.rotation).Conjugate());
-    nodeTM.SetTrans(reinterpret_cast<const Point3 &>(boneTM.position) *
-                    IDC_EDIT_SCALE_value);
-    nodeTM.Scale(reinterpret_cast<const Point3 &>(boneTM.scale));
-
-    short parentID = boneData->boneLinks.data[b];
-    if (parentID > -1) {
-      nodes[parentID]->AttachChild(node);
-      nodeTM *= nodes[parentID]->GetNodeTM(0);
+    nodeTM.SetRotate(reinterpret_cast<const Quat &>(b.rotation).Conjugate());
+    nodeTM.SetTrans(reinterpret_cast<const Point3 &>(b.position));
+    nodeTM.Scale(reinterpret_cast<const Point3 &>(b.scale));
+
+    if (b.parentID > -1) {
+      nodes[b.parentID]->AttachChild(node);
+      nodeTM *= nodes[b.parentID]->GetNodeTM(0);
     } else
       nodeTM *= corMat;
 
     node->SetNodeTM(0, nodeTM);
     node->SetName(ToBoneName(boneName));
-    node->SetUserPropInt(_T("XenoBone"), b);
+    node->SetUserPropInt(_T("XenoBone"), static_cast<int>(nodes.size()));
+    nodeNames.AddNode(node);
     nodes.push_back(node);
   }
+
+  // Existing nodes could be renumbered
+  iBoneScanner.Invalidate();
 }
 
-static class : public ITreeEnumProc {
-  const MSTR boneNameHint = _T("XenoBone");
+static Matrix3 GetLocalTM(INode *node, TimeValue time) {
+  INode *parent = node->GetParentNode();
+  Matrix3 localTM = node->GetNodeTM(time);
 
-public:
-  std::vector<INode *> bones;
+  if (!parent->IsRootNode())
+    localTM *= Inverse(parent->GetNodeTM(time));
 
-  void RescanBones() {
-    bones.clear();
-    GetCOREInterface7()->GetScene()->EnumTree(this);
-  }
+  return localTM;
+}
 
-  INode *LookupNode(int ID) {
-    for (auto &b : bones)
-      if (b->UserPropExists(boneNameHint)) {
-        int _ID;
-        b->GetUserPropInt(boneNameHint, _ID);
+static XenoRestPose GetRestPose() {
+  iBoneScanner.RescanBones();
+  XenoRestPose restPose;
 
-        if (_ID == ID)
-          return b;
-      }
+  for (auto &b : iBoneScanner.Bones())
+    restPose.emplace(b.second, GetLocalTM(b.second, 0));
 
-    return nullptr;
-  }
+  return restPose;
+}
 
-  int callback(INode *node) {
-    if (node->UserPropExists(boneNameHint))
-      bones.push_back(node);
+static void SetLinearControllers(Control *cnt) {
+  if (cnt->GetPositionController()->ClassID() !=
+      Class_ID(LININTERP_POSITION_CLASS_ID, 0))
+    cnt->SetPositionController((Control *)CreateInstance(
+        CTRL_POSITION_CLASS_ID, Class_ID(LININTERP_POSITION_CLASS_ID, 0)));
+
+  if (cnt->GetRotationController()->ClassID() !=
+      Class_ID(LININTERP_ROTATION_CLASS_ID, 0))
+    cnt->SetRotationController((Control *)CreateInstance(
+        CTRL_ROTATION_CLASS_ID, Class_ID(LININTERP_ROTATION_CLASS_ID, 0)));
+
+  if (cnt->GetScaleController()->ClassID() !=
+      Class_ID(LININTERP_SCALE_CLASS_ID, 0))
+    cnt->SetScaleController((Control *)CreateInstance(
+        CTRL_SCALE_CLASS_ID, Class_ID(LININTERP_SCALE_CLASS_ID, 0)));
+}
 
-    return TREE_CONTINUE;
+// Animated bones and their ancestors in topological order, parents first.
+// Ancestors without track keep their rest transform.
+struct AnimHierarchy {
+  std::vector<int> parents;     // -1: child of scene root
+  std::vector<int> tracks;      // -1: no track
+  std::vector<Matrix3> restTMs; // local, world for children of scene root
+  std::unordered_map<INode *, int> indices;
+  const XenoRestPose *restPose = nullptr; // null: current pose at frame 0
+
+  int AddNode(INode *node, int track) {
+    auto found = indices.find(node);
+
+    if (found != indices.end()) {
+      if (track > -1)
+        tracks[found->second] = track;
+
+      return found->second;
+    }
+
+    INode *parent = node->GetParentNode();
+    const int parentID = parent->IsRootNode() ? -1 : AddNode(parent, -1);
+    const Matrix3 restTM = restPose && restPose->count(node)
+                               ? restPose->at(node)
+                               : GetLocalTM(node, 0);
+
+    const int index = static_cast<int>(parents.size());
+    parents.push_back(parentID);
+    tracks.push_back(track);
+    restTMs.push_back(restTM);
+    indices.emplace(node, index);
+
+    return index;
   }
-} iBoneScanner;
+};
 
-void XenoImp::LoadAnimation(BCANIM *anim) {
+// Keys animation from startFrame on, returns number of frames.
+// With restPose, every other bone is held in rest over the clip's range and
+// each channel is keyed up to the last frame, so ranges don't blend together.
+int XenoImp::LoadAnimation(BCANIM *anim, XenoThreadPool &pool, int startFrame,
+                           const XenoRestPose *restPose) {
   iBoneScanner.RescanBones();
-  TimeValue numTicks = SecToTicks(anim->frameTime * anim->frameCount);
+  const XenoSettings settings = GetSettings();
+  XenoAnimation xAnim = XenoBakeAnimation(
+      anim, XenoFrameGrid(anim, static_cast<float>(GetFrameRate())), settings,
+      pool);
   TimeValue ticksPerFrame = GetTicksPerFrame();
-  TimeValue overlappingTicks = numTicks % ticksPerFrame;
+  const int numFrames = static_cast<int>(xAnim.frameTimes.size());
+  const int numTracks = static_cast<int>(xAnim.tracks.size());
+  const bool globalFrames = flags[IDC_CH_GLOBAL_FRAMES_checked];
+  std::vector<INode *> nodes(numTracks);
+  std::vector<char> rootNodes(numTracks);
 
-  if (overlappingTicks > (ticksPerFrame / 2))
-    numTicks += ticksPerFrame - overlappingTicks;
-  else
-    numTicks -= overlappingTicks;
+  for (int t = 0; t < numTracks; t++) {
+    const int boneID = xAnim.tracks[t].boneID;
+    INode *foundNode = iBoneScanner.LookupNode(boneID);
 
-  Interval aniRange(0, numTicks - ticksPerFrame);
-  GetCOREInterface()->SetAnimRange(aniRange);
+    if (!foundNode) {
+      printwarning("[Xeno] Couldn't find XenoBone: ", << boneID);
+      continue;
+    }
 
-  std::vector<float> frameTimes;
+    nodes[t] = foundNode;
+    rootNodes[t] = foundNode->GetParentNode()->IsRootNode();
+  }
 
-  for (TimeValue v = 0; v <= aniRange.End(); v += GetTicksPerFrame())
-    frameTimes.push_back(TicksToSec(v));
+  // Evaluate final local transforms of all bones up front, scene is touched
+  // only by sequential commit below
+  std::vector<Matrix3> frameTMs(static_cast<size_t>(numTracks) * numFrames);
 
-  const int numAniBones = anim->animData->boneCount;
+  if (globalFrames) {
+    // Tracks are in world space, locals are solved against parent worlds of
+    // same frame, whole skeleton at once, parents first
+    AnimHierarchy hierarchy;
+    hierarchy.restPose = restPose;
 
-  for (int a = 0; a < numAniBones; a++) {
-    const short boneID = anim->animData->boneTableOffset[a];
+    for (int t = 0; t < numTracks; t++)
+      if (nodes[t])
+        hierarchy.AddNode(nodes[t], t);
 
-    if (boneID < 0)
-      continue;
+    const int numBones = static_cast<int>(hierarchy.parents.size());
 
-    INode *foundNode = iBoneScanner.LookupNode(a);
+    XenoParallelFor(pool, numFrames, [&](int f) {
+      std::vector<Matrix3> worldTMs(numBones);
 
-    if (!foundNode) {
-      printwarning("[Xeno] Couldn't find XenoBone: ", << a);
-      continue;
-    }
+      for (int b = 0; b < numBones; b++) {
+        const int t = hierarchy.tracks[b];
+        const int parentID = hierarchy.parents[b];
+        Matrix3 &worldTM = worldTMs[b];
 
-    Control *cnt = foundNode->GetTMController();
+        if (t < 0) {
+          worldTM = hierarchy.restTMs[b];
+
+          if (parentID > -1)
+            worldTM *= worldTMs[parentID];
+
+          continue;
+        }
+
+        worldTM = ToMatrix3(xAnim.tracks[t].GetFrame(f)) * corMat;
+        frameTMs[static_cast<size_t>(t) * numFrames + f] =
+            parentID > -1 ? worldTM * Inverse(worldTMs[parentID]) : worldTM;
+      }
+    });
+  } else {
+    XenoParallelFor(pool, numTracks, [&](int t) {
+      if (!nodes[t])
+        return;
+
+      const XenoAnimTrack &track = xAnim.tracks[t];
+      Matrix3 *trackTMs =
+          frameTMs.data() + static_cast<size_t>(t) * numFrames;
+
+      for (int f = 0; f < numFrames; f++) {
+        Matrix3 cMat = ToMatrix3(track.GetFrame(f));
+
+        if (rootNodes[t])
+          cMat *= corMat;
 
-    if (cnt->GetPositionController()->ClassID() !=
-        Class_ID(LININTERP_POSITION_CLASS_ID, 0))
-      cnt->SetPositionController((Control *)CreateInstance(
-          CTRL_POSITION_CLASS_ID, Class_ID(LININTERP_POSITION_CLASS_ID, 0)));
+        trackTMs[f] = cMat;
+      }
+    });
+  }
 
-    if (cnt->GetRotationController()->ClassID() !=
-        Class_ID(LININTERP_ROTATION_CLASS_ID, 0))
-      cnt->SetRotationController((Control *)CreateInstance(
-          CTRL_ROTATION_CLASS_ID, Class_ID(LININTERP_ROTATION_CLASS_ID, 0)));
+  const TimeValue startTime = startFrame * ticksPerFrame;
+  const TimeValue endTime = startTime + (numFrames - 1) * ticksPerFrame;
+  Interval aniRange(0, endTime);
+  GetCOREInterface()->SetAnimRange(aniRange);
 
-    if (cnt->GetScaleController()->ClassID() !=
-        Class_ID(LININTERP_SCALE_CLASS_ID, 0))
-      cnt->SetScaleController((Control *)CreateInstance(
-          CTRL_SCALE_CLASS_ID, Class_ID(LININTERP_SCALE_CLASS_ID, 0)));
+  if (restPose) {
+    std::unordered_set<INode *> animated(nodes.begin(), nodes.end());
+
+    for (auto &r : *restPose) {
+      if (animated.count(r.first))
+        continue;
+
+      Control *cnt = r.first->GetTMController();
+      SetLinearControllers(cnt);
+      SuspendAnimate();
+      AnimateOn();
+      SetXFormPacket packet(r.second);
+      cnt->SetValue(startTime, &packet);
+      cnt->SetValue(endTime, &packet);
+      AnimateOff();
+    }
+  }
+
+  for (int t = 0; t < numTracks; t++) {
+    INode *foundNode = nodes[t];
+
+    if (!foundNode)
+      continue;
+
+    Control *cnt = foundNode->GetTMController();
+    SetLinearControllers(cnt);
 
     SuspendAnimate();
     AnimateOn();
 
-    cnt->AddNewKey(-ticksPerFrame, 0);
+    // Rest key before first range only, later ones would overwrite last frame
+    // of previous clip
+    if (!startFrame)
+      cnt->AddNewKey(-ticksPerFrame, 0);
 
-    for (auto &t : frameTimes) {
-      BCANIM::TransformFrame evalTransform;
+    const Matrix3 *trackTMs =
+        frameTMs.data() + static_cast<size_t>(t) * numFrames;
 
-      anim->tracks.data[boneID].GetTransform(t, evalTransform, anim);
+    if (settings.reduceKeys) {
+      const XenoAnimTrack &track = xAnim.tracks[t];
+      AffineParts parts;
+      std::vector<int> keys[3];
 
-      Matrix3 cMat;
-      Quat &rots = reinterpret_cast<Quat &>(evalTransform.rotation);
-      cMat.SetRotate(rots.Conjugate());
-      cMat.SetTrans(reinterpret_cast<Point3 &>(evalTransform.position) *
-                    IDC_EDIT_SCALE_value);
-      cMat.Scale(reinterpret_cast<Point3 &>(evalTransform.scale));
+      for (int c = 0; c < 3; c++) {
+        keys[c] = track.keys[c];
 
-      if (!flags[IDC_CH_GLOBAL_FRAMES_checked]) {
-        if (foundNode->GetParentNode()->IsRootNode())
-          cMat *= corMat;
+        // Static channels are keyed at first frame only
+        if (restPose && !keys[c].empty() && keys[c].back() != numFrames - 1)
+          keys[c].push_back(numFrames - 1);
+      }
 
-        SetXFormPacket packet(cMat);
-        cnt->SetValue(SecToTicks(t), &packet);
-      } else {
-        foundNode->SetNodeTM(SecToTicks(t), cMat * corMat);
+      for (int f : keys[0]) {
+        decomp_affine(trackTMs[f], &parts);
+        cnt->GetPositionController()->SetValue(
+            startTime + f * ticksPerFrame, &parts.t, 1, CTRL_ABSOLUTE);
+      }
+
+      for (int f : keys[1]) {
+        decomp_affine(trackTMs[f], &parts);
+        cnt->GetRotationController()->SetValue(
+            startTime + f * ticksPerFrame, &parts.q, 1, CTRL_ABSOLUTE);
+      }
+
+      for (int f : keys[2]) {
+        decomp_affine(trackTMs[f], &parts);
+        ScaleValue scale(parts.k * parts.f, parts.u);
+        cnt->GetScaleController()->SetValue(startTime + f * ticksPerFrame,
+                                            &scale, 1, CTRL_ABSOLUTE);
+      }
+    } else {
+      for (int f = 0; f < numFrames; f++) {
+        SetXFormPacket packet(trackTMs[f]);
+        cnt->SetValue(startTime + f * ticksPerFrame, &packet);
       }
     }
 
@@ -309,6 +628,8 @@ void XenoImp::LoadAnimation(BCANIM *anim) {
     rotControl->Copy(cnt->GetRotationController());
     cnt->GetRotationController()->Copy(rotControl);
   }
+
+  return numFrames;
 }
 
 int XenoImp::LoadTextures(MXMD *model) {
@@ -364,6 +685,24 @@ int XenoImp::LoadTextures(MXMD *model) {
   return -1;
 }
 
+// Assigns extracted textures finished so far, with wait all pending ones.
+void XenoImp::HookupTextures(bool wait) {
+  std::vector<XenoExtractedTexture> finished;
+
+  while (numPendingTextures) {
+    finished.clear();
+    texQueue.Pop(finished, wait);
+    numPendingTextures -= static_cast<int>(finished.size());
+
+    for (auto &f : finished)
+      if (f.path.size() && f.textureID < texmaps.size())
+        texmaps[f.textureID]->SetMapName(f.path.c_str());
+
+    if (!wait)
+      break;
+  }
+}
+
 void XenoImp::LoadMaterials(MXMD *model) {
   MXMDMaterials::Ptr mats = model->GetMaterials();
 
@@ -440,17 +779,14 @@ void XenoImp::LoadMaterials(MXMD *model) {
   }
 }
 
-INodeTab XenoImp::LoadMeshes(MXMD *model, MXMDModel::Ptr &mdl, int curGroup) {
+INodeTab XenoImp::LoadMeshes(std::vector<XenoMesh> &meshes, int curGroup) {
   ILayerManager *manager = GetCOREInterface13()->GetLayerManager();
   TSTRING assName(_T("Group"));
   INodeTab outNodes;
-  MXMDGeomBuffers::Ptr geom = model->GetGeometry(curGroup);
 
-  if (!geom)
+  if (!meshes.size())
     return {};
 
-  MXMDMeshGroup::Ptr group = mdl->GetMeshGroup(curGroup);
-
   MSTR curAssName = assName.c_str();
   curAssName.append(ToTSTRING(curGroup).c_str());
 
@@ -459,196 +795,87 @@ INodeTab XenoImp::LoadMeshes(MXMD *model, MXMDModel::Ptr &mdl, int curGroup) {
   if (!currLayer)
     currLayer = manager->CreateLayer(curAssName);
 
-  int currentMesh = 0;
-  const int numMeshes = group->GetNumMeshObjects();
-  outNodes.Resize(numMeshes);
+  outNodes.Resize(static_cast<int>(meshes.size()));
 
-  for (int m = 0; m < numMeshes; m++) {
-    MXMDMeshObject::Ptr mObj = group->GetMeshObject(m);
-
-    const int meshFacesID = mObj->GetUVFacesID();
-    MXMDFaceBuffer::Ptr fBuffer = geom->GetFaceBuffer(meshFacesID);
-    MXMDVertexBuffer::Ptr vBuffer = geom->GetVertexBuffer(mObj->GetBufferID());
-    const int numVerts = vBuffer->NumVertices();
-    const int numFaces = fBuffer->GetNumIndices() / 3;
+  for (auto &xMesh : meshes) {
+    const XenoMeshBuffers &buffers = *xMesh.buffers;
+    const int numVerts = static_cast<int>(buffers.positions.size());
+    const int numFaces = static_cast<int>(buffers.faces.size());
     TriObject *obj = CreateNewTriObject();
     Mesh *msh = &obj->GetMesh();
     msh->setNumVerts(numVerts);
     msh->setNumFaces(numFaces);
 
-    const USVector *fBuff = fBuffer->GetBuffer();
-    MXMDVertexBuffer::DescriptorCollection descs = vBuffer->GetDescriptors();
     INodeSuffixer suff;
-    int currentMap = 1;
-    MXMDVertexDescriptor *skinDesc = nullptr;
-
-    for (auto &d : descs)
-      switch (d->Type()) {
-      case MXMD_POSITION: {
-        for (int v = 0; v < numVerts; v++) {
-          Point3 temp;
-          d->Evaluate(v, &temp);
-          temp *= IDC_EDIT_SCALE_value;
-          msh->setVert(v, corMat.VectorTransform(temp));
-        }
-        break;
-      }
-      case MXMD_UV1:
-      case MXMD_UV2:
-      case MXMD_UV3: {
-        msh->setMapSupport(currentMap, 1);
-        msh->setNumMapVerts(currentMap, numVerts);
-        msh->setNumMapFaces(currentMap, numFaces);
-        suff.AddChannel(currentMap);
-
-        for (int v = 0; v < numVerts; v++) {
-          Vector2 temp;
-          d->Evaluate(v, &temp);
-          msh->Map(currentMap).tv[v] = {temp.X, 1.f - temp.Y, 0.f};
-        }
 
-        currentMap++;
-        break;
-      }
-      case MXMD_NORMAL:
-      case MXMD_NORMAL2:
-      case MXMD_NORMAL32: {
-        suff.UseNormals();
-        MeshNormalSpec *normalSpec;
-        msh->SpecifyNormals();
-        normalSpec = msh->GetSpecifiedNormals();
-        normalSpec->ClearNormals();
-        normalSpec->SetNumNormals(numVerts);
-        normalSpec->SetNumFaces(numFaces);
-
-        for (int v = 0; v < numVerts; v++) {
-          Point3 temp;
-          d->Evaluate(v, &temp);
-          normalSpec->Normal(v) = corMat.VectorTransform(temp);
-          normalSpec->SetNormalExplicit(v, true);
-        }
+    for (int v = 0; v < numVerts; v++)
+      msh->setVert(v,
+                   reinterpret_cast<const Point3 &>(buffers.positions[v]));
 
-        for (int f = 0; f < numFaces; f++) {
-          MeshNormalFace &normalFace = normalSpec->Face(f);
-          const USVector &tmp = fBuff[f];
-          normalFace.SpecifyAll();
-          normalFace.SetNormalID(0, tmp.X);
-          normalFace.SetNormalID(1, tmp.Y);
-          normalFace.SetNormalID(2, tmp.Z);
-        }
-        break;
-      }
-      case MXMD_VERTEXCOLOR: {
-        msh->setMapSupport(-2, 1);
-        msh->setNumMapVerts(-2, numVerts);
-        msh->setNumMapFaces(-2, numFaces);
-        msh->setMapSupport(0, 1);
-        msh->setNumMapVerts(0, numVerts);
-        msh->setNumMapFaces(0, numFaces);
-        suff.AddChannel(0);
-        suff.AddChannel(-2);
-
-        for (int v = 0; v < numVerts; v++) {
-          Vector4 temp;
-          d->Evaluate(v, &temp);
-          msh->Map(0).tv[v] = reinterpret_cast<Point3 &>(temp);
-          msh->Map(-2).tv[v] = {temp.W, temp.W, temp.W};
-        }
-        break;
-      }
-      case MXMD_WEIGHTID:
-        skinDesc = d.get();
-        break;
-      default:
-        break;
-      }
+    for (auto &m : buffers.maps) {
+      msh->setMapSupport(m.mapID, 1);
+      msh->setNumMapVerts(m.mapID, numVerts);
+      msh->setNumMapFaces(m.mapID, numFaces);
+      suff.AddChannel(m.mapID);
+      memcpy(msh->Map(m.mapID).tv, m.verts.data(), numVerts * sizeof(Point3));
+    }
 
-    MXMDMorphTargets::Ptr morphs =
-        geom->GetVertexBufferMorphTargets(mObj->GetBufferID());
+    MeshNormalSpec *normalSpec = nullptr;
 
-    if (morphs) {
-      suff.UseMorph();
-      MXMDVertexBuffer::DescriptorCollection morphDescs =
-          morphs->GetBaseMorph();
-
-      for (auto &d : morphDescs)
-        switch (d->Type()) {
-        case MXMD_POSITION: {
-          for (int v = 0; v < numVerts; v++) {
-            Point3 temp;
-            d->Evaluate(v, &temp);
-            temp *= IDC_EDIT_SCALE_value;
-            msh->setVert(v, corMat.VectorTransform(temp));
-          }
-          break;
-        }
+    if (buffers.normals.size()) {
+      suff.UseNormals();
+      msh->SpecifyNormals();
+      normalSpec = msh->GetSpecifiedNormals();
+      normalSpec->ClearNormals();
+      normalSpec->SetNumNormals(numVerts);
+      normalSpec->SetNumFaces(numFaces);
 
-        case MXMD_NORMALMORPH: {
-          suff.UseNormals();
-          MeshNormalSpec *normalSpec;
-          msh->SpecifyNormals();
-          normalSpec = msh->GetSpecifiedNormals();
-          normalSpec->ClearNormals();
-          normalSpec->SetNumNormals(numVerts);
-          normalSpec->SetNumFaces(numFaces);
-
-          for (int v = 0; v < numVerts; v++) {
-            Vector4 temp;
-            d->Evaluate(v, &temp);
-            normalSpec->Normal(v) =
-                corMat.VectorTransform(reinterpret_cast<Point3 &>(temp));
-            normalSpec->SetNormalExplicit(v, true);
-          }
-
-          for (int f = 0; f < numFaces; f++) {
-            MeshNormalFace &normalFace = normalSpec->Face(f);
-            const USVector &tmp = fBuff[f];
-            normalFace.SpecifyAll();
-            normalFace.SetNormalID(0, tmp.X);
-            normalFace.SetNormalID(1, tmp.Y);
-            normalFace.SetNormalID(2, tmp.Z);
-          }
-          break;
-        }
-        }
+      for (int v = 0; v < numVerts; v++) {
+        normalSpec->Normal(v) =
+            reinterpret_cast<const Point3 &>(buffers.normals[v]);
+        normalSpec->SetNormalExplicit(v, true);
+      }
     }
 
+    if (buffers.hasMorphs)
+      suff.UseMorph();
+
+    // Geometry, normal and map faces share indices, fill them at once
+    std::vector<TVFace *> mapFaces;
+
+    for (int &i : suff)
+      mapFaces.push_back(msh->Map(i).tf);
+
     for (int f = 0; f < numFaces; f++) {
       Face &face = msh->faces[f];
       face.setEdgeVisFlags(1, 1, 1);
-      const USVector &tmp = fBuff[f];
+      const USVector &tmp = buffers.faces[f];
       face.v[0] = tmp.X;
       face.v[1] = tmp.Y;
       face.v[2] = tmp.Z;
 
-      for (int &i : suff)
-        msh->Map(i).tf[f].setTVerts(tmp.X, tmp.Y, tmp.Z);
+      for (auto &m : mapFaces)
+        m[f].setTVerts(tmp.X, tmp.Y, tmp.Z);
+
+      if (normalSpec) {
+        MeshNormalFace &normalFace = normalSpec->Face(f);
+        normalFace.SpecifyAll();
+        normalFace.SetNormalID(0, tmp.X);
+        normalFace.SetNormalID(1, tmp.Y);
+        normalFace.SetNormalID(2, tmp.Z);
+      }
     }
 
-    msh->DeleteIsoVerts();
-    msh->DeleteIsoMapVerts();
     msh->InvalidateGeomCache();
     msh->InvalidateTopologyCache();
 
     INode *nde = GetCOREInterface()->CreateObjectNode(obj);
-    int gibid = mObj->GetGibID();
-    TSTRING nodeName;
+    TSTRING nodeName = esStringConvert<TCHAR>(xMesh.name.c_str());
 
-    if (gibid) {
-      nodeName.append(_T("Part"));
-      nodeName.append(ToTSTRING(gibid));
-    } else {
-      nodeName.append(_T("Object"));
-      nodeName.append(ToTSTRING(currentMesh));
-      currentMesh++;
-    }
-
-    int LOD = mObj->GetLODID();
-
-    if (LOD > 0) {
+    if (xMesh.LOD > 0) {
       MSTR curAssName = assName.c_str();
       curAssName.append(ToTSTRING(curGroup).c_str());
-      curAssName.append(_T("_LOD")).append(ToTSTRING(LOD).c_str());
+      curAssName.append(_T("_LOD")).append(ToTSTRING(xMesh.LOD).c_str());
 
       ILayer *currLODLayer = manager->GetLayer(curAssName);
 
@@ -661,21 +888,19 @@ INodeTab XenoImp::LoadMeshes(MXMD *model, MXMDModel::Ptr &mdl, int curGroup) {
 
     suff.node = nde;
 
-    if (morphs)
-      ApplyMorph(morphs, nde, msh, mObj, mdl, geom);
+    if (buffers.morphs.size())
+      ApplyMorph(xMesh, nde);
 
-    if (skinDesc)
-      ApplySkin(geom, mObj, suff, msh->faces, skinDesc);
+    if (xMesh.skin.vertexSets.size())
+      ApplySkin(xMesh, suff);
 
     if (flags[IDC_CH_DEBUGNAME_checked])
       nodeName.append(suff.Generate());
 
     nde->SetName(ToBoneName(nodeName));
 
-    const int matID = mObj->GetMaterialID();
-
-    if (matID < outMats.size())
-      nde->SetMtl(outMats[matID]);
+    if (xMesh.materialID < outMats.size())
+      nde->SetMtl(outMats[xMesh.materialID]);
 
     outNodes.AppendNode(nde);
   }
@@ -692,20 +917,28 @@ void XenoImp::LoadModels(MXMD *model) {
   LoadModelPose(mdl);
 
   const int numMeshGroups = mdl->GetNumMeshGroups();
+  std::vector<int> groups(numMeshGroups);
 
   for (int g = 0; g < numMeshGroups; g++)
-    LoadMeshes(model, mdl, g);
+    groups[g] = g;
+
+  const XenoSettings settings = GetSettings();
+  XenoThreadPool pool(settings.numThreads);
+  std::vector<std::vector<XenoMesh>> meshes =
+      XenoDecodeMeshGroups(model, mdl, groups, settings, pool, meshCache);
+
+  for (int g = 0; g < numMeshGroups; g++) {
+    LoadMeshes(meshes[g], g);
+    HookupTextures(false);
+  }
 }
 
 void XenoImp::LoadModelPose(MXMDModel::Ptr &model) {
-  const int numBones = model->GetNumSkinBones();
-
-  for (int b = 0; b < numBones; b++) {
-    MXMDBone::Ptr cBone = model->GetSkinBone(b);
+  std::vector<XenoPoseBone> bones = XenoDecodeModelPose(model, GetSettings());
 
-    const char *_boneName = cBone->GetName();
-    TSTRING boneName = esString(_boneName);
-    INode *node = GetCOREInterface()->GetINodeByName(boneName.c_str());
+  for (auto &b : bones) {
+    TSTRING boneName = esStringConvert<TCHAR>(b.name.c_str());
+    INode *node = nodeNames.LookupNode(boneName);
 
     if (!node) {
       Object *obj = static_cast<Object *>(
@@ -714,15 +947,9 @@ void XenoImp::LoadModelPose(MXMDModel::Ptr &model) {
       node->ShowBone(2);
       node->SetWireColor(0x80ff);
       node->SetName(ToBoneName(boneName));
+      nodeNames.AddNode(node);
 
-      Matrix3 nodeTM = {};
-      const MXMDTransformMatrix *bneMat = cBone->GetAbsTransform();
-
-      nodeTM.SetRow(0, reinterpret_cast<const Point3 &>(bneMat->m[0]));
-      nodeTM.SetRow(1, reinterpret_cast<const Point3 &>(bneMat->m[1]));
-      nodeTM.SetRow(2, reinterpret_cast<const Point3 &>(bneMat->m[2]));
-      nodeTM.SetRow(3, reinterpret_cast<const Point3 &>(bneMat->m[3]) *
-                           IDC_EDIT_SCALE_value);
+      Matrix3 nodeTM = ToMatrix3(b.bindTM);
       nodeTM.Invert();
       node->SetNodeTM(0, nodeTM * corMat);
     }
@@ -730,25 +957,19 @@ void XenoImp::LoadModelPose(MXMDModel::Ptr &model) {
     remapNodes.push_back(node);
   }
 
-  for (int b = 0; b < numBones; b++) {
-    MXMDBone::Ptr cBone = model->GetSkinBone(b);
-    int parentID = cBone->GetParentID();
+  for (size_t b = 0; b < bones.size(); b++) {
+    if (!bones[b].parentName.size())
+      continue;
 
-    if (parentID > -1) {
-      MXMDBone::Ptr pBone = model->GetBone(parentID);
-      const char *_pboneName = pBone->GetName();
-      TSTRING pBoneName = esString(_pboneName);
-      INode *pNode = GetCOREInterface()->GetINodeByName(pBoneName.c_str());
+    TSTRING pBoneName = esStringConvert<TCHAR>(bones[b].parentName.c_str());
+    INode *pNode = nodeNames.LookupNode(pBoneName);
 
-      if (pNode)
-        pNode->AttachChild(remapNodes[b]);
-    }
+    if (pNode)
+      pNode->AttachChild(remapNodes[b]);
   }
 }
 
-void XenoImp::ApplySkin(MXMDGeomBuffers::Ptr &buff, MXMDMeshObject::Ptr &mesh,
-                        INodeSuffixer &nde, Face *mfac,
-                        MXMDVertexDescriptor *skinDesc) {
+void XenoImp::ApplySkin(XenoMesh &mesh, INodeSuffixer &nde) {
   if (!remapNodes.size())
     return;
   else if (remapNodes.size() == 1) {
@@ -756,14 +977,6 @@ void XenoImp::ApplySkin(MXMDGeomBuffers::Ptr &buff, MXMDMeshObject::Ptr &mesh,
     return;
   }
 
-  const int skindesc =
-      ((mesh->GetLODID() << 8) & 0xff00) | mesh->GetSkinDesc() & 0xff;
-
-  MXMDGeomVertexWeightBuffer::Ptr wtBuff = buff->GetWeightsBuffer(skindesc);
-
-  if (!buff)
-    return;
-
   nde.UseSkin();
 
   Modifier *cmod = (Modifier *)GetCOREInterface()->CreateInstance(OSM_CLASS_ID,
@@ -772,47 +985,41 @@ void XenoImp::ApplySkin(MXMDGeomBuffers::Ptr &buff, MXMDMeshObject::Ptr &mesh,
   ISkinImportData *cskin =
       (ISkinImportData *)cmod->GetInterface(I_SKINIMPORTDATA);
 
-  for (auto &r : remapNodes)
-    cskin->AddBoneEx(r, false);
+  const XenoSkin &skin = mesh.skin;
+
+  for (auto &b : skin.usedBones)
+    cskin->AddBoneEx(remapNodes[b], false);
 
   static_cast<INode *>(nde)->EvalWorldState(0);
 
-  const int meshFacesID = mesh->GetUVFacesID();
-  MXMDVertexBuffer::Ptr vBuffer = buff->GetVertexBuffer(mesh->GetBufferID());
-  MXMDFaceBuffer::Ptr fBuffer = buff->GetFaceBuffer(meshFacesID);
-  const int numVerts = vBuffer->NumVertices();
-  const int numFaces = fBuffer->GetNumIndices() / 3;
-  const USVector *fBuff = fBuffer->GetBuffer();
-  BitArray btarr(numVerts);
-
-  for (int f = 0; f < numFaces; f++) {
-    const USVector &cFaceBegin = fBuff[f];
-    for (int s = 0; s < 3; s++) {
-      const int &cfseg = mfac[f].v[s];
-      if (!btarr[cfseg]) {
-        ushort vtid = 0;
-        skinDesc->Evaluate(cFaceBegin[s], &vtid);
-
-        MXMDVertexWeight cWtOut = wtBuff->GetVertexWeight(vtid);
-        Tab<INode *> cbn;
-        Tab<float> cwt;
-        cbn.SetCount(4);
-        cwt.SetCount(4);
-        for (int u = 0; u < 4; u++) {
-          cbn[u] = remapNodes[cWtOut.boneids[u]];
-          cwt[u] = cWtOut.weights[u];
-        }
-        cskin->AddWeights(nde, cfseg, cbn, cwt);
+  // Influence tabs are built once per unique set, then shared by vertices
+  const int numSets = skin.NumSets();
+  std::vector<Tab<INode *>> setNodes(numSets);
+  std::vector<Tab<float>> setWeights(numSets);
 
-        btarr.Set(cfseg);
-      }
+  for (int s = 0; s < numSets; s++) {
+    const int begin = skin.setOffsets[s];
+    const int numInfluences = skin.setOffsets[s + 1] - begin;
+    setNodes[s].SetCount(numInfluences);
+    setWeights[s].SetCount(numInfluences);
+
+    for (int u = 0; u < numInfluences; u++) {
+      setNodes[s][u] = remapNodes[skin.usedBones[skin.setBones[begin + u]]];
+      setWeights[s][u] = skin.setWeights[begin + u];
     }
   }
+
+  const int numVerts = static_cast<int>(skin.vertexSets.size());
+
+  for (int v = 0; v < numVerts; v++) {
+    const int setID = skin.vertexSets[v];
+
+    if (setNodes[setID].Count())
+      cskin->AddWeights(nde, v, setNodes[setID], setWeights[setID]);
+  }
 }
 
-void XenoImp::ApplyMorph(MXMDMorphTargets::Ptr &morphs, INode *node, Mesh *mesh,
-                         MXMDMeshObject::Ptr &msh, MXMDModel::Ptr &mdl,
-                         MXMDGeomBuffers::Ptr &buff) {
+void XenoImp::ApplyMorph(XenoMesh &mesh, INode *node) {
   Modifier *cmod = (Modifier *)GetCOREInterface()->CreateInstance(OSM_CLASS_ID,
                                                                   MR3_CLASS_ID);
   GetCOREInterface7()->AddModifier(*node, *cmod);
@@ -820,122 +1027,76 @@ void XenoImp::ApplyMorph(MXMDMorphTargets::Ptr &morphs, INode *node, Mesh *mesh,
   MaxMorphModifier morpher = {};
   morpher.Init(cmod);
 
-  const int targetcount = morphs->GetNumMorphs();
-  const int meshFacesID = msh->GetUVFacesID();
-  MXMDVertexBuffer::Ptr vBuffer = buff->GetVertexBuffer(msh->GetBufferID());
-  MXMDFaceBuffer::Ptr fBuffer = buff->GetFaceBuffer(meshFacesID);
-  const int numVerts = vBuffer->NumVertices();
-  const int numFaces = fBuffer->GetNumIndices() / 3;
-  const USVector *fBuff = fBuffer->GetBuffer();
-  BitArray btarr(numVerts);
+  const int numVerts = static_cast<int>(mesh.buffers->positions.size());
   int currentChannel = 0;
 
-  for (int m = 0; m < targetcount; m++) {
-    MXMDVertexBuffer::DescriptorCollection morph = morphs->GetDeltaMorph(m);
-
+  for (auto &m : mesh.buffers->morphs) {
     MaxMorphChannel &chan = morpher.GetMorphChannel(currentChannel);
-    chan.Reset(true, true, mesh->numVerts);
+    // Reset only resizes deltas, emptied table comes back value initialized,
+    // so only sparse deltas are written
+    chan.mDeltas.clear();
+    chan.Reset(true, true, numVerts);
 
-    TSTRING morphName = esString(mdl->GetMorphName(morphs->GetMorphNameID(m)));
+    TSTRING morphName = esStringConvert<TCHAR>(m.name.c_str());
 
     if (!morphName.size())
       morphName = _T("Morph ") + ToTSTRING(currentChannel);
 
     chan.SetName(morphName.c_str());
 
-    for (int v = 0; v < mesh->numVerts; v++)
-      chan.SetMorphPointDelta(v, Point3{0, 0, 0});
-
-    btarr.ClearAll();
-
-    std::vector<int> IDS;
-
-    for (auto &m : morph)
-      switch (m->Type()) {
-      case MXMD_MORPHVERTEXID: {
-        const int numItems = m->Size();
-        IDS.resize(numItems);
-
-        for (int i = 0; i < numItems; i++)
-          m->Evaluate(i, &IDS[i]);
-
-        break;
-      }
-      case MXMD_POSITION: {
-        int currentNumberOfChannelVertices = 0;
-
-        for (int f = 0; f < numFaces; f++) {
-          const USVector &cFaceBegin = fBuff[f];
-
-          for (int s = 0; s < 3; s++) {
-            const int &cfseg = mesh->faces[f].v[s];
-
-            if (!btarr[cfseg]) {
-              int currentMorphVertID = 0;
-
-              for (auto &cid : IDS) {
-                if (cFaceBegin[s] == cid) {
-                  Point3 pos;
-                  m->Evaluate(currentMorphVertID, &pos);
-                  chan.SetMorphPointDelta(cfseg, corMat.VectorTransform(pos));
-                  currentNumberOfChannelVertices++;
-                }
-                currentMorphVertID++;
-              }
-              btarr.Set(cfseg);
-            }
-          }
-        }
+    const int numDeltas = static_cast<int>(m.indices.size());
 
-        if (currentNumberOfChannelVertices)
-          currentChannel++;
+    for (int d = 0; d < numDeltas; d++)
+      chan.SetMorphPointDelta(m.indices[d],
+                              reinterpret_cast<const Point3 &>(m.deltas[d]));
 
-        break;
-      }
-      }
+    currentChannel++;
   }
 }
 
 int XenoImp::LoadInstances(MXMD *model) {
   MXMDModel::Ptr mdl = model->GetModel();
-  MXMDInstances::Ptr insts = model->GetInstances();
+  std::vector<XenoInstance> insts = XenoDecodeInstances(model, GetSettings());
 
-  if (!mdl || !insts)
+  if (!mdl || !insts.size())
     return 1;
 
-  const int numInstances = insts->GetNumInstances();
   const int numGroups = mdl->GetNumMeshGroups();
   std::vector<INodeTab> instances(numGroups);
+  std::vector<int> usedGroups;
+  std::vector<int> groupSlots(numGroups, -1);
+
+  for (auto &i : insts)
+    for (auto &meshGroupID : i.groups)
+      if (meshGroupID < numGroups && meshGroupID >= 0 &&
+          groupSlots[meshGroupID] < 0) {
+        groupSlots[meshGroupID] = static_cast<int>(usedGroups.size());
+        usedGroups.push_back(meshGroupID);
+      }
 
-  for (int i = 0; i < numInstances; i++) {
-    const MXMDTransformMatrix *mtx = insts->GetTransform(i);
-
-    int groupBegin = insts->GetStartingGroup(i);
-    const int groupEnd = groupBegin + insts->GetNumGroups(i);
-
-    for (groupBegin; groupBegin < groupEnd; groupBegin++) {
-      int meshGroupID = insts->GetMeshGroup(groupBegin);
+  const XenoSettings settings = GetSettings();
+  XenoThreadPool pool(settings.numThreads);
+  std::vector<std::vector<XenoMesh>> groupMeshes =
+      XenoDecodeMeshGroups(model, mdl, usedGroups, settings, pool, meshCache);
 
-      if (meshGroupID > numGroups || meshGroupID < 0)
+  for (auto &i : insts) {
+    for (auto &meshGroupID : i.groups) {
+      if (meshGroupID >= numGroups || meshGroupID < 0)
         continue;
 
       INodeTab meshes;
 
       if (!instances[meshGroupID].Count()) {
-        meshes = LoadMeshes(model, mdl, meshGroupID);
+        meshes = LoadMeshes(groupMeshes[groupSlots[meshGroupID]], meshGroupID);
         instances[meshGroupID] = meshes;
+        HookupTextures(false);
       } else
         GetCOREInterface()->CloneNodes(instances[meshGroupID], Point3(), false,
                                        NODE_INSTANCE, nullptr, &meshes);
 
       for (int m = 0; m < meshes.Count(); m++) {
         INode *node = meshes[m];
-        Matrix3 nodeTM = {};
-        nodeTM.SetRow(0, reinterpret_cast<const Point3 &>(mtx->m[0]));
-        nodeTM.SetRow(1, reinterpret_cast<const Point3 &>(mtx->m[1]));
-        nodeTM.SetRow(2, reinterpret_cast<const Point3 &>(mtx->m[2]));
-        nodeTM.SetRow(3, reinterpret_cast<const Point3 &>(mtx->m[3]) *
-                             IDC_EDIT_SCALE_value);
+        Matrix3 nodeTM = ToMatrix3(i.transform);
         Matrix3 nodeTM2 = corMat;
         nodeTM2.Invert();
         nodeTM2 *= nodeTM;
@@ -1019,38 +1180,74 @@ int XenoImp::LoadANM(const TCHAR *filename, BOOL suppressPrompts,
     if (!SpawnANIDialog())
       return 0;
 
-  LoadAnimation(anm);
+  XenoThreadPool pool(GetSettings().numThreads);
+  LoadAnimation(anm, pool);
 
   return 0;
 }
 
-int XenoImp::LoadMOT(const TCHAR *filename, BOOL suppressPrompts,
-                     bool subLoad) {
-  SAR arcFile;
-  int loadResult = arcFile.Load(filename, !subLoad);
+// Comma separated motion indices, empty set selects all motions.
+static std::vector<int> ParseMotionSet(const TSTRING &set, size_t numMotions) {
+  std::vector<int> indices;
+  size_t begin = 0;
 
-  if (loadResult)
-    return loadResult;
+  while (begin < set.size()) {
+    size_t end = set.find(_T(','), begin);
 
-  for (int f = 0; f < arcFile.NumFiles(); f++) {
-    AFileInfo fleInfo(arcFile.GetFileName(f));
+    if (end == set.npos)
+      end = set.size();
 
-    if (fleInfo.GetExtension().compare(".anm"))
+    const TSTRING item = set.substr(begin, end - begin);
+    begin = end + 1;
+
+    if (item.find_first_not_of(_T(" \t")) == item.npos)
       continue;
 
-    BC anmFile;
+    TCHAR *itemEnd;
+    const long index = _tcstol(item.c_str(), &itemEnd, 10);
 
-    if (anmFile.Link(arcFile.GetFile(f)))
+    if (itemEnd == item.c_str()) {
+      printwarning("[Xeno] Skipping non numeric motion set entry at: ",
+                   << end - item.size());
       continue;
+    }
 
-    BCANIM *anm = anmFile.GetClass<BCANIM>();
-
-    if (!anm)
+    if (index < 0 || static_cast<size_t>(index) >= numMotions) {
+      printwarning("[Xeno] Motion index out of range: ", << index);
       continue;
+    }
 
+    indices.push_back(static_cast<int>(index));
+  }
+
+  if (indices.empty() && set.find_first_not_of(_T(" \t,")) == set.npos)
+    for (size_t m = 0; m < numMotions; m++)
+      indices.push_back(static_cast<int>(m));
+
+  return indices;
+}
+
+int XenoImp::LoadMOT(const TCHAR *filename, BOOL suppressPrompts,
+                     bool subLoad) {
+  SAR arcFile;
+  bool arcLoaded = false;
+  std::shared_ptr<const XenoMotionCatalog> catalog =
+      XenoFindMotionCatalog(filename);
+
+  if (!catalog) {
+    int loadResult = arcFile.Load(filename, !subLoad);
+
+    if (loadResult)
+      return loadResult;
+
+    arcLoaded = true;
+    catalog = XenoScanMotionCatalog(filename, arcFile);
+  }
+
+  for (auto &m : *catalog) {
     XenoImp::MotionPair mtPair;
-    mtPair.name = fleInfo.GetFileName().c_str();
-    mtPair.ID = f;
+    mtPair.name = m.name;
+    mtPair.ID = m.fileID;
 
     motions.push_back(mtPair);
   }
@@ -1059,12 +1256,65 @@ int XenoImp::LoadMOT(const TCHAR *filename, BOOL suppressPrompts,
     if (!SpawnANIDialog())
       return 0;
 
+  if (!motions.size())
+    return 0;
+
+  if (!arcLoaded) {
+    int loadResult = arcFile.Load(filename, !subLoad);
+
+    if (loadResult)
+      return loadResult;
+  }
+
+  XenoThreadPool pool(GetSettings().numThreads);
+
+  if (flags[IDC_CH_ALLMOTIONS_checked]) {
+    // Clips go one after another, every range starts with clip note
+    DefNoteTrack *clipNotes = nullptr;
+    const XenoRestPose restPose = GetRestPose();
+    int startFrame = 0;
+
+    for (int i : ParseMotionSet(motionSet, motions.size())) {
+      const MotionPair &m = motions[i];
+      BC anmFile;
+
+      if (anmFile.Link(arcFile.GetFile(m.ID)))
+        continue;
+
+      BCANIM *anm = anmFile.GetClass<BCANIM>();
+
+      if (!anm)
+        continue;
+
+      const int numFrames = LoadAnimation(anm, pool, startFrame, &restPose);
+
+      if (!clipNotes)
+        clipNotes = static_cast<DefNoteTrack *>(NewDefaultNoteTrack());
+
+      clipNotes->keys.Append(
+          1, new NoteKey(startFrame * GetTicksPerFrame(),
+                         esStringConvert<TCHAR>(m.name.c_str()).c_str()));
+      startFrame += numFrames;
+    }
+
+    if (clipNotes)
+      GetCOREInterface()->GetRootNode()->AddNoteTrack(clipNotes);
+
+    return 0;
+  }
+
+  if (IDC_CB_MOTIONINDEX_index >= motions.size())
+    IDC_CB_MOTIONINDEX_index = 0;
+
   BC anmFile;
   anmFile.Link(arcFile.GetFile(motions[IDC_CB_MOTIONINDEX_index].ID));
 
   BCANIM *anm = anmFile.GetClass<BCANIM>();
 
-  LoadAnimation(anm);
+  if (!anm)
+    return -1;
+
+  LoadAnimation(anm, pool);
 
   return 0;
 }
@@ -1111,32 +1361,66 @@ int XenoImp::LoadMXMD(const TCHAR *filename, ImpInterface *importerInt,
 
   TSTRING folderPath = fleInfo.GetPath() + fleInfo.GetFileName() + _T("/");
 
-  std::thread texThread;
+  // Textures are extracted while meshes are built, finished ones are hooked
+  // up between mesh groups
+  std::unique_ptr<XenoTextureCache> texCache;
+  XenoThreadPool texPool(GetSettings().numTextureThreads);
+  const int textureLocation = LoadTextures(&mainModel);
+  numPendingTextures = 0;
 
-  if (flags[IDC_CH_TEXTURES_checked])
-    texThread = std::thread([&] {
-      MXMDTextures::Ptr textures = mainModel.GetTextures();
-
-      if (!textures)
-        return;
+  if (flags[IDC_CH_TEXTURES_checked]) {
+    MXMDTextures::Ptr textures = mainModel.GetTextures();
 
+    if (textures) {
       TextureConversionParams params;
       params.allowBC5ZChan = !flags[IDC_CH_BC5BCHAN_checked];
       params.uncompress = flags[IDC_CH_TOPNG_checked];
 
       _tmkdir(folderPath.c_str());
 
-      textures->ExtractAllTextures(folderPath.c_str(), params);
-    });
+      if (IDC_EDIT_TEXCACHE_value > 0.f) {
+        TSTRING cachePath =
+            IPathConfigMgr::GetPathConfigMgr()->GetDir(APP_PLUGCFG_DIR);
+        cachePath.append(_T("\\XenoTextureCache\\"));
+        texCache.reset(new XenoTextureCache(
+            cachePath, static_cast<uint64_t>(IDC_EDIT_TEXCACHE_value) << 20));
+      }
 
-  int textureLocation = LoadTextures(&mainModel);
+      const XenoPNGProfile profile =
+          flags[IDC_CH_FASTPNG_checked] ? XenoPNG_Fast : XenoPNG_Max;
+      numPendingTextures = textures->GetNumTextures();
+      XenoExtractTextures(textures, folderPath, params, profile, texPool,
+                          &texQueue, texCache.get(), filename);
+    }
+  }
+
+  const bool texturesExtracted = numPendingTextures > 0;
   LoadMaterials(&mainModel);
 
+  meshCache.Clear();
+
   if (LoadInstances(&mainModel))
     LoadModels(&mainModel);
 
-  if (texThread.joinable())
-    texThread.join();
+  printline("[Xeno] Mesh buffer cache: ", << meshCache.hits << " hits, "
+                                          << meshCache.misses << " misses");
+  printline("[Xeno] Weight palette cache: ",
+            << meshCache.paletteHits << " hits, " << meshCache.paletteMisses
+            << " misses");
+  meshCache.Clear();
+
+  HookupTextures(true);
+  texPool.Wait();
+
+  if (texCache)
+    printline("[Xeno] Texture cache: ", << texCache->hits << " hits, "
+                                        << texCache->misses << " misses");
+
+  if (texturesExtracted)
+    return 0;
+
+  // Textures from previous extraction or external ones, .png is preferred
+  PNGFileIndex PNGFiles;
 
   for (auto &t : texmaps) {
     const TCHAR *texName = t->GetName();
@@ -1152,7 +1436,7 @@ int XenoImp::LoadMXMD(const TCHAR *filename, ImpInterface *importerInt,
     } else
       texFullPath = folderPath + texName;
 
-    if (DoesFileExist((texFullPath + _T(".png")).c_str(), false))
+    if (PNGFiles.Contains(texFullPath))
       texFullPath.append(_T(".png"));
     else
       texFullPath.append(_T(".dds"));
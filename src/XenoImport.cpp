@@ -34,6 +34,12 @@ const TCHAR _homePage[] = _T("https://lukascone.wordpress.com/2019/06/04/")
 
 XenoImport::XenoImport()
     : CFGFile(nullptr), hWnd(nullptr), IDConfigValue(IDC_EDIT_SCALE)(145.f),
+      IDConfigValue(IDC_EDIT_LODBUDGET)(100000.f),
+      IDConfigValue(IDC_EDIT_TEXTHREADS)(0.f),
+      IDConfigValue(IDC_EDIT_TEXCACHE)(2048.f),
+      IDConfigValue(IDC_EDIT_POSTOLERANCE)(0.01f),
+      IDConfigValue(IDC_EDIT_ROTTOLERANCE)(0.1f),
+      IDConfigValue(IDC_EDIT_SCLTOLERANCE)(0.001f),
       flags(IDC_CH_DEBUGNAME_checked) {
   LoadCFG();
 }
@@ -44,13 +50,27 @@ void XenoImport::LoadCFG() {
 
   GetCFGValue(IDC_EDIT_SCALE);
   GetCFGIndex(IDC_CB_MOTIONINDEX);
+  GetCFGIndex(IDC_CB_LODPOLICY);
+  GetCFGValue(IDC_EDIT_LODBUDGET);
+  GetCFGValue(IDC_EDIT_TEXTHREADS);
+  GetCFGValue(IDC_EDIT_TEXCACHE);
+  GetCFGValue(IDC_EDIT_POSTOLERANCE);
+  GetCFGValue(IDC_EDIT_ROTTOLERANCE);
+  GetCFGValue(IDC_EDIT_SCLTOLERANCE);
   GetCFGChecked(IDC_CH_DEBUGNAME);
   GetCFGChecked(IDC_CH_BC5BCHAN);
   GetCFGChecked(IDC_CH_TEXTURES);
   GetCFGChecked(IDC_CH_TOPNG);
   GetCFGChecked(IDC_CH_GLOBAL_FRAMES);
+  GetCFGChecked(IDC_CH_REDUCEKEYS);
+  GetCFGChecked(IDC_CH_ALLMOTIONS);
+  GetCFGChecked(IDC_CH_FASTPNG);
   GetCFGEnabled(IDC_CH_BC5BCHAN);
   GetCFGEnabled(IDC_CH_TOPNG);
+
+  GetPrivateProfileString(_T("XenoImp"), _T("MotionSet"), _T(""), buffer,
+                          CFGBufferSize, CFGFile);
+  motionSet = buffer;
 }
 
 void XenoImport::BuildCFG() {
@@ -65,13 +85,25 @@ void XenoImport::SaveCFG() {
   TCHAR buffer[CFGBufferSize];
   SetCFGValue(IDC_EDIT_SCALE);
   SetCFGIndex(IDC_CB_MOTIONINDEX);
+  SetCFGIndex(IDC_CB_LODPOLICY);
+  SetCFGValue(IDC_EDIT_LODBUDGET);
+  SetCFGValue(IDC_EDIT_TEXTHREADS);
+  SetCFGValue(IDC_EDIT_TEXCACHE);
+  SetCFGValue(IDC_EDIT_POSTOLERANCE);
+  SetCFGValue(IDC_EDIT_ROTTOLERANCE);
+  SetCFGValue(IDC_EDIT_SCLTOLERANCE);
   SetCFGChecked(IDC_CH_DEBUGNAME);
   SetCFGChecked(IDC_CH_BC5BCHAN);
   SetCFGChecked(IDC_CH_TEXTURES);
   SetCFGChecked(IDC_CH_GLOBAL_FRAMES);
+  SetCFGChecked(IDC_CH_REDUCEKEYS);
+  SetCFGChecked(IDC_CH_ALLMOTIONS);
+  SetCFGChecked(IDC_CH_FASTPNG);
   SetCFGChecked(IDC_CH_TOPNG);
   SetCFGEnabled(IDC_CH_BC5BCHAN);
   SetCFGEnabled(IDC_CH_TOPNG);
+  WritePrivateProfileString(_T("XenoImp"), _T("MotionSet"),
+                            motionSet.c_str(), CFGFile);
 
   WriteText(hkpresetgroup, _T("Xenoblade"), CFGFile, _T("Name"));
   WriteValue(hkpresetgroup, IDConfigValue(IDC_EDIT_SCALE), CFGFile, buffer,
@@ -124,6 +156,42 @@ static INT_PTR CALLBACK DialogCallbacks(HWND hWnd, UINT message, WPARAM wParam,
                     : imp->IDC_CB_MOTIONINDEX_index,
                 0);
 
+    HWND LODCombo = GetDlgItem(hWnd, IDC_CB_LODPOLICY);
+
+    if (LODCombo) {
+      static const TCHAR *LODPolicies[] = {_T("All LODs"), _T("Base LOD only"),
+                                           _T("Triangle budget")};
+
+      for (auto &p : LODPolicies)
+        SendMessage(LODCombo, CB_ADDSTRING, 0, (LPARAM)p);
+
+      if (imp->IDC_CB_LODPOLICY_index >= _countof(LODPolicies))
+        imp->IDC_CB_LODPOLICY_index = 0;
+
+      SendMessage(LODCombo, CB_SETCURSEL, imp->IDC_CB_LODPOLICY_index, 0);
+      SetupIntSpinner(hWnd, IDC_SPIN_LODBUDGET, IDC_EDIT_LODBUDGET, 0,
+                      100000000, imp->IDC_EDIT_LODBUDGET_value);
+      SetupIntSpinner(hWnd, IDC_SPIN_TEXTHREADS, IDC_EDIT_TEXTHREADS, 0, 256,
+                      imp->IDC_EDIT_TEXTHREADS_value);
+      SetupIntSpinner(hWnd, IDC_SPIN_TEXCACHE, IDC_EDIT_TEXCACHE, 0, 1000000,
+                      imp->IDC_EDIT_TEXCACHE_value);
+    }
+
+    if (GetDlgItem(hWnd, IDC_CH_REDUCEKEYS)) {
+      SetupFloatSpinner(hWnd, IDC_SPIN_POSTOLERANCE, IDC_EDIT_POSTOLERANCE, 0,
+                        100, imp->IDC_EDIT_POSTOLERANCE_value);
+      SetupFloatSpinner(hWnd, IDC_SPIN_ROTTOLERANCE, IDC_EDIT_ROTTOLERANCE, 0,
+                        180, imp->IDC_EDIT_ROTTOLERANCE_value);
+      SetupFloatSpinner(hWnd, IDC_SPIN_SCLTOLERANCE, IDC_EDIT_SCLTOLERANCE, 0,
+                        10, imp->IDC_EDIT_SCLTOLERANCE_value);
+    }
+
+    if (HWND motionSet = GetDlgItem(hWnd, IDC_EDIT_MOTIONSET)) {
+      SetWindowText(motionSet, imp->motionSet.c_str());
+      EnableWindow(motionSet,
+                   imp->flags[XenoImport::IDC_CH_ALLMOTIONS_checked]);
+    }
+
     return TRUE;
   }
 
@@ -183,6 +251,18 @@ static INT_PTR CALLBACK DialogCallbacks(HWND hWnd, UINT message, WPARAM wParam,
     case IDC_BT_ABOUT:
       ShowAboutDLG(hWnd);
       return 1;
+    case IDC_EDIT_MOTIONSET:
+      if (HIWORD(wParam) == EN_CHANGE) {
+        TCHAR buffer[CFGBufferSize];
+        GetWindowText((HWND)lParam, buffer, CFGBufferSize);
+        imp->motionSet = buffer;
+      }
+      return 1;
+    case IDC_CB_LODPOLICY:
+      if (HIWORD(wParam) == CBN_SELCHANGE)
+        imp->IDC_CB_LODPOLICY_index =
+            SendMessage((HWND)lParam, CB_GETCURSEL, 0, 0);
+      return 1;
     case IDCANCEL:
       EndDialog(hWnd, 0);
       imp->SaveCFG();
@@ -201,6 +281,17 @@ static INT_PTR CALLBACK DialogCallbacks(HWND hWnd, UINT message, WPARAM wParam,
       MSGCheckbox(IDC_CH_GLOBAL_FRAMES);
       break;
 
+      MSGCheckbox(IDC_CH_REDUCEKEYS);
+      break;
+
+      MSGCheckbox(IDC_CH_ALLMOTIONS);
+      EnableWindow(GetDlgItem(hWnd, IDC_EDIT_MOTIONSET),
+                   imp->flags[XenoImport::IDC_CH_ALLMOTIONS_checked]);
+      break;
+
+      MSGCheckbox(IDC_CH_FASTPNG);
+      break;
+
       MSGCheckbox(IDC_CH_TOPNG);
       MSGEnable(IDC_CH_TOPNG, IDC_CH_BC5BCHAN);
       break;
@@ -212,6 +303,30 @@ static INT_PTR CALLBACK DialogCallbacks(HWND hWnd, UINT message, WPARAM wParam,
       imp->IDC_EDIT_SCALE_value =
           reinterpret_cast<ISpinnerControl *>(lParam)->GetFVal();
       break;
+    case IDC_SPIN_LODBUDGET:
+      imp->IDC_EDIT_LODBUDGET_value = static_cast<float>(
+          reinterpret_cast<ISpinnerControl *>(lParam)->GetIVal());
+      break;
+    case IDC_SPIN_TEXTHREADS:
+      imp->IDC_EDIT_TEXTHREADS_value = static_cast<float>(
+          reinterpret_cast<ISpinnerControl *>(lParam)->GetIVal());
+      break;
+    case IDC_SPIN_TEXCACHE:
+      imp->IDC_EDIT_TEXCACHE_value = static_cast<float>(
+          reinterpret_cast<ISpinnerControl *>(lParam)->GetIVal());
+      break;
+    case IDC_SPIN_POSTOLERANCE:
+      imp->IDC_EDIT_POSTOLERANCE_value =
+          reinterpret_cast<ISpinnerControl *>(lParam)->GetFVal();
+      break;
+    case IDC_SPIN_ROTTOLERANCE:
+      imp->IDC_EDIT_ROTTOLERANCE_value =
+          reinterpret_cast<ISpinnerControl *>(lParam)->GetFVal();
+      break;
+    case IDC_SPIN_SCLTOLERANCE:
+      imp->IDC_EDIT_SCLTOLERANCE_value =
+          reinterpret_cast<ISpinnerControl *>(lParam)->GetFVal();
+      break;
     }
   case IDC_CB_MOTIONINDEX: {
     switch (HIWORD(wParam)) {
@@ -37,6 +37,14 @@ public:
 
   NewIDConfigValue(IDC_EDIT_SCALE);
   NewIDConfigIndex(IDC_CB_MOTIONINDEX);
+  NewIDConfigIndex(IDC_CB_LODPOLICY);
+  NewIDConfigValue(IDC_EDIT_LODBUDGET);
+  NewIDConfigValue(IDC_EDIT_TEXTHREADS);
+  NewIDConfigValue(IDC_EDIT_TEXCACHE);
+  NewIDConfigValue(IDC_EDIT_POSTOLERANCE);
+  NewIDConfigValue(IDC_EDIT_ROTTOLERANCE);
+  NewIDConfigValue(IDC_EDIT_SCLTOLERANCE);
+  TSTRING motionSet; // comma separated indices for all motions, empty: all
 
   int windowSize, button1Distance, button2Distance;
 
@@ -46,11 +54,14 @@ public:
     IDConfigBool(IDC_CH_TEXTURES),
     IDConfigBool(IDC_CH_TOPNG),
     IDConfigBool(IDC_CH_GLOBAL_FRAMES),
+    IDConfigBool(IDC_CH_REDUCEKEYS),
+    IDConfigBool(IDC_CH_ALLMOTIONS),
+    IDConfigBool(IDC_CH_FASTPNG),
     IDConfigVisible(IDC_CH_BC5BCHAN),
     IDConfigVisible(IDC_CH_TOPNG),
   };
 
-  EnumFlags<uchar, ConfigBoolean> flags;
+  EnumFlags<ushort, ConfigBoolean> flags;
 
   struct MotionPair {
     std::string name;
@@ -30,5 +30,6 @@
 #include <impexp.h>
 
 void PrintOffThreadMessages();
+void ReleaseBoneScanner();
 
 extern HINSTANCE hInstance;
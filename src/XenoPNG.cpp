@@ -0,0 +1,915 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "XenoPNG.h"
+#include "XenoBCn.h"
+#include "XenoThreads.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+const int lengthBase[] = {3,  4,  5,  6,   7,   8,   9,   10,  11, 13,
+                          15, 17, 19, 23,  27,  31,  35,  43,  51, 59,
+                          67, 83, 99, 115, 131, 163, 195, 227, 258};
+const int lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                           2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const int distanceBase[] = {1,    2,    3,    4,     5,     7,    9,    13,
+                            17,   25,   33,   49,    65,    97,   129,  193,
+                            257,  385,  513,  769,   1025,  1537, 2049, 3073,
+                            4097, 6145, 8193, 12289, 16385, 24577};
+const int distanceExtra[] = {0, 0, 0,  0,  1,  1,  2,  2,  3,  3,
+                             4, 4, 5,  5,  6,  6,  7,  7,  8,  8,
+                             9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+struct DeflateTables {
+  // Bit reversed fixed Huffman code with extra bits appended
+  uint32_t literals[256];
+  uint8_t literalBits[256];
+  uint32_t lengths[259];
+  uint8_t lengthBits[259];
+  uint8_t lengthCodes[259];   // length -> index into lengthBase
+  uint8_t distanceCodes[512]; // distance - 1 < 256, then (distance - 1) >> 7
+  uint32_t crc[256];
+
+  static uint32_t Reverse(uint32_t code, int numBits) {
+    uint32_t result = 0;
+
+    for (int b = 0; b < numBits; b++)
+      result |= ((code >> b) & 1) << (numBits - 1 - b);
+
+    return result;
+  }
+
+  static void FixedCode(int symbol, uint32_t &code, int &numBits) {
+    if (symbol < 144) {
+      code = 0x30 + symbol;
+      numBits = 8;
+    } else if (symbol < 256) {
+      code = 0x190 + symbol - 144;
+      numBits = 9;
+    } else if (symbol < 280) {
+      code = symbol - 256;
+      numBits = 7;
+    } else {
+      code = 0xc0 + symbol - 280;
+      numBits = 8;
+    }
+
+    code = Reverse(code, numBits);
+  }
+
+  DeflateTables() {
+    for (int s = 0; s < 256; s++) {
+      int numBits;
+      FixedCode(s, literals[s], numBits);
+      literalBits[s] = static_cast<uint8_t>(numBits);
+    }
+
+    for (int c = 0; c < 29; c++) {
+      const int end = c < 28 ? lengthBase[c + 1] : 259;
+
+      for (int l = lengthBase[c]; l < end; l++) {
+        uint32_t code;
+        int numBits;
+        FixedCode(257 + c, code, numBits);
+        lengths[l] = code | ((l - lengthBase[c]) << numBits);
+        lengthBits[l] = static_cast<uint8_t>(numBits + lengthExtra[c]);
+        lengthCodes[l] = static_cast<uint8_t>(c);
+      }
+    }
+
+    for (int c = 0; c < 30; c++) {
+      const int end = c < 29 ? distanceBase[c + 1] : 32769;
+
+      for (int d = distanceBase[c]; d < end; d++) {
+        if (d <= 256)
+          distanceCodes[d - 1] = static_cast<uint8_t>(c);
+        else
+          distanceCodes[256 + ((d - 1) >> 7)] = static_cast<uint8_t>(c);
+      }
+    }
+
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+
+      for (int k = 0; k < 8; k++)
+        c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+
+      crc[n] = c;
+    }
+  }
+};
+
+const DeflateTables &GetDeflateTables() {
+  static const DeflateTables tables;
+  return tables;
+}
+
+class BitWriter {
+  std::vector<uchar> &out;
+  uint64_t bits = 0;
+  int numBits = 0;
+
+public:
+  explicit BitWriter(std::vector<uchar> &out) : out(out) {}
+
+  void Write(uint32_t value, int count) {
+    bits |= static_cast<uint64_t>(value) << numBits;
+    numBits += count;
+
+    while (numBits >= 8) {
+      out.push_back(static_cast<uchar>(bits));
+      bits >>= 8;
+      numBits -= 8;
+    }
+  }
+
+  void Align() {
+    if (numBits)
+      Write(0, 8 - numBits);
+  }
+};
+
+} // namespace
+
+static uint32_t ReadU32(const uchar *data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// Single fixed Huffman block, greedy matching with one candidate per hash.
+// Final block is padded to byte, others are followed by empty stored block,
+// so next strip starts byte aligned.
+static void Deflate(const uchar *data, size_t size, bool final,
+                    std::vector<uchar> &out) {
+  const DeflateTables &tables = GetDeflateTables();
+  const int hashBits = 15;
+  const size_t maxDistance = 32768;
+  std::vector<int> head(1 << hashBits, -1);
+  BitWriter writer(out);
+  writer.Write(final ? 3 : 2, 3);
+
+  auto literal = [&](uchar value) {
+    writer.Write(tables.literals[value], tables.literalBits[value]);
+  };
+
+  size_t i = 0;
+
+  while (i + 4 <= size) {
+    const uint32_t sequence = ReadU32(data + i);
+    const uint32_t hash = (sequence * 2654435761U) >> (32 - hashBits);
+    const int candidate = head[hash];
+    head[hash] = static_cast<int>(i);
+
+    if (candidate < 0 || i - candidate > maxDistance ||
+        ReadU32(data + candidate) != sequence) {
+      literal(data[i++]);
+      continue;
+    }
+
+    size_t length = 4;
+    const size_t maxLength = size - i < 258 ? size - i : 258;
+
+    while (length < maxLength && data[candidate + length] == data[i + length])
+      length++;
+
+    const int distance = static_cast<int>(i - candidate);
+    const int code = distance <= 256
+                         ? tables.distanceCodes[distance - 1]
+                         : tables.distanceCodes[256 + ((distance - 1) >> 7)];
+
+    writer.Write(tables.lengths[length], tables.lengthBits[length]);
+    writer.Write(DeflateTables::Reverse(code, 5), 5);
+    writer.Write(distance - distanceBase[code], distanceExtra[code]);
+    i += length;
+  }
+
+  while (i < size)
+    literal(data[i++]);
+
+  writer.Write(0, 7); // end of block
+
+  if (!final) {
+    writer.Write(0, 3);
+    writer.Align();
+    const uchar emptyStored[] = {0, 0, 0xff, 0xff};
+    out.insert(out.end(), emptyStored, emptyStored + 4);
+  } else
+    writer.Align();
+}
+
+static int DistanceCode(const DeflateTables &tables, int distance) {
+  return distance <= 256 ? tables.distanceCodes[distance - 1]
+                         : tables.distanceCodes[256 + ((distance - 1) >> 7)];
+}
+
+// Huffman code lengths of at most maxBits, frequencies are halved until
+// tree fits. Unused symbols get 0.
+static void BuildCodeLengths(const uint32_t *freqs, int numSymbols,
+                             int maxBits, uint8_t *lengths) {
+  std::vector<uint32_t> weights(freqs, freqs + numSymbols);
+  memset(lengths, 0, numSymbols);
+
+  for (;;) {
+    // Nodes are sorted by weight, leaves first on ties
+    std::vector<std::pair<uint32_t, int>> leaves;
+
+    for (int s = 0; s < numSymbols; s++)
+      if (weights[s])
+        leaves.emplace_back(weights[s], s);
+
+    if (leaves.size() < 2) {
+      if (leaves.size())
+        lengths[leaves[0].second] = 1;
+
+      return;
+    }
+
+    std::sort(leaves.begin(), leaves.end());
+    const int numLeaves = static_cast<int>(leaves.size());
+    std::vector<uint32_t> nodeWeights(numLeaves * 2 - 1);
+    std::vector<int> parents(numLeaves * 2 - 1, -1);
+
+    for (int l = 0; l < numLeaves; l++)
+      nodeWeights[l] = leaves[l].first;
+
+    // Two queue construction, inner nodes are created in weight order
+    int leaf = 0, inner = numLeaves, numNodes = numLeaves;
+
+    auto takeLowest = [&]() {
+      if (leaf < numLeaves &&
+          (inner >= numNodes || nodeWeights[leaf] <= nodeWeights[inner]))
+        return leaf++;
+
+      return inner++;
+    };
+
+    while (numNodes < numLeaves * 2 - 1) {
+      const int a = takeLowest();
+      const int b = takeLowest();
+      nodeWeights[numNodes] = nodeWeights[a] + nodeWeights[b];
+      parents[a] = parents[b] = numNodes++;
+    }
+
+    std::vector<int> depths(numNodes);
+    int maxDepth = 0;
+
+    for (int n = numNodes - 2; n >= 0; n--) {
+      depths[n] = depths[parents[n]] + 1;
+
+      if (n < numLeaves && depths[n] > maxDepth)
+        maxDepth = depths[n];
+    }
+
+    if (maxDepth <= maxBits) {
+      for (int l = 0; l < numLeaves; l++)
+        lengths[leaves[l].second] = static_cast<uint8_t>(depths[l]);
+
+      return;
+    }
+
+    for (auto &w : weights)
+      if (w)
+        w = (w >> 1) | 1;
+  }
+}
+
+// Canonical codes, bit reversed for writing.
+static void BuildCodes(const uint8_t *lengths, int numSymbols,
+                       uint32_t *codes) {
+  int counts[16] = {};
+  uint32_t nextCodes[16] = {};
+
+  for (int s = 0; s < numSymbols; s++)
+    counts[lengths[s]]++;
+
+  counts[0] = 0;
+
+  for (int b = 1; b < 16; b++)
+    nextCodes[b] = (nextCodes[b - 1] + counts[b - 1]) << 1;
+
+  for (int s = 0; s < numSymbols; s++)
+    if (lengths[s])
+      codes[s] = DeflateTables::Reverse(nextCodes[lengths[s]]++, lengths[s]);
+}
+
+namespace {
+struct LZSymbol {
+  uint16_t value;    // literal or match length
+  uint16_t distance; // 0 for literal
+};
+} // namespace
+
+// Single dynamic Huffman block of symbols.
+static void WriteDynamicBlock(BitWriter &writer, const LZSymbol *symbols,
+                              size_t numSymbols, bool final) {
+  const DeflateTables &tables = GetDeflateTables();
+  uint32_t literalFreqs[286] = {}, distanceFreqs[30] = {};
+  literalFreqs[256] = 1;
+
+  for (size_t i = 0; i < numSymbols; i++) {
+    const LZSymbol &sym = symbols[i];
+
+    if (sym.distance) {
+      literalFreqs[257 + tables.lengthCodes[sym.value]]++;
+      distanceFreqs[DistanceCode(tables, sym.distance)]++;
+    } else
+      literalFreqs[sym.value]++;
+  }
+
+  uint8_t lengths[286 + 30];
+  uint8_t *distanceLengths = lengths + 286;
+  BuildCodeLengths(literalFreqs, 286, 15, lengths);
+  BuildCodeLengths(distanceFreqs, 30, 15, distanceLengths);
+
+  if (std::find_if(distanceLengths, distanceLengths + 30,
+                   [](uint8_t l) { return l != 0; }) == distanceLengths + 30)
+    distanceLengths[0] = 1;
+
+  int numLiterals = 286, numDistances = 30;
+
+  while (numLiterals > 257 && !lengths[numLiterals - 1])
+    numLiterals--;
+
+  while (numDistances > 1 && !distanceLengths[numDistances - 1])
+    numDistances--;
+
+  // Code lengths of both alphabets as one run length encoded sequence
+  uint8_t sequence[286 + 30];
+  memcpy(sequence, lengths, numLiterals);
+  memcpy(sequence + numLiterals, distanceLengths, numDistances);
+  const int sequenceSize = numLiterals + numDistances;
+  std::vector<std::pair<uint8_t, uint8_t>> runs; // symbol, extra bits value
+  uint32_t runFreqs[19] = {};
+
+  auto addRun = [&](int symbol, int extra) {
+    runs.emplace_back(static_cast<uint8_t>(symbol),
+                      static_cast<uint8_t>(extra));
+    runFreqs[symbol]++;
+  };
+
+  for (int i = 0; i < sequenceSize;) {
+    const uint8_t value = sequence[i];
+    int run = 1;
+
+    while (i + run < sequenceSize && sequence[i + run] == value)
+      run++;
+
+    i += run;
+
+    if (!value) {
+      for (; run >= 11; run -= std::min(run, 138))
+        addRun(18, std::min(run, 138) - 11);
+
+      if (run >= 3) {
+        addRun(17, run - 3);
+        run = 0;
+      }
+    } else {
+      addRun(value, 0);
+      run--;
+
+      for (; run >= 3; run -= std::min(run, 6))
+        addRun(16, std::min(run, 6) - 3);
+    }
+
+    for (; run > 0; run--)
+      addRun(value, 0);
+  }
+
+  static const uint8_t runOrder[] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                     11, 4,  12, 3, 13, 2, 14, 1, 15};
+  static const int runExtraBits[] = {2, 3, 7};
+  uint8_t runLengths[19];
+  uint32_t runCodes[19];
+  BuildCodeLengths(runFreqs, 19, 7, runLengths);
+  BuildCodes(runLengths, 19, runCodes);
+
+  int numRunLengths = 19;
+
+  while (numRunLengths > 4 && !runLengths[runOrder[numRunLengths - 1]])
+    numRunLengths--;
+
+  writer.Write(final ? 5 : 4, 3);
+  writer.Write(numLiterals - 257, 5);
+  writer.Write(numDistances - 1, 5);
+  writer.Write(numRunLengths - 4, 4);
+
+  for (int r = 0; r < numRunLengths; r++)
+    writer.Write(runLengths[runOrder[r]], 3);
+
+  for (auto &r : runs) {
+    writer.Write(runCodes[r.first], runLengths[r.first]);
+
+    if (r.first >= 16)
+      writer.Write(r.second, runExtraBits[r.first - 16]);
+  }
+
+  uint32_t literalCodes[286], distanceCodes[30];
+  BuildCodes(lengths, 286, literalCodes);
+  BuildCodes(distanceLengths, 30, distanceCodes);
+
+  for (size_t i = 0; i < numSymbols; i++) {
+    const LZSymbol &sym = symbols[i];
+
+    if (!sym.distance) {
+      writer.Write(literalCodes[sym.value], lengths[sym.value]);
+      continue;
+    }
+
+    const int lengthCode = tables.lengthCodes[sym.value];
+    const int distanceCode = DistanceCode(tables, sym.distance);
+    writer.Write(literalCodes[257 + lengthCode], lengths[257 + lengthCode]);
+    writer.Write(sym.value - lengthBase[lengthCode], lengthExtra[lengthCode]);
+    writer.Write(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+    writer.Write(sym.distance - distanceBase[distanceCode],
+                 distanceExtra[distanceCode]);
+  }
+
+  writer.Write(literalCodes[256], lengths[256]);
+}
+
+// Dynamic Huffman blocks, lazy matching over hash chains. Same block
+// alignment as Deflate.
+static void DeflateMax(const uchar *data, size_t size, bool final,
+                       std::vector<uchar> &out) {
+  const int hashBits = 15;
+  const int maxChain = 256;
+  const size_t maxDistance = 32768;
+  const size_t niceLength = 258;
+  const size_t blockSymbols = 1 << 15;
+  std::vector<int> head(1 << hashBits, -1);
+  std::vector<int> prev(size);
+  std::vector<LZSymbol> symbols;
+  symbols.reserve(blockSymbols);
+  BitWriter writer(out);
+
+  auto hashAt = [&](size_t i) {
+    const uint32_t sequence = data[i] | (data[i + 1] << 8) |
+                              (data[i + 2] << 16);
+    return (sequence * 2654435761U) >> (32 - hashBits);
+  };
+
+  // Every position up to end is chained before its matches are searched
+  size_t numInserted = 0;
+
+  auto insertTo = [&](size_t end) {
+    for (; numInserted <= end && numInserted + 3 <= size; numInserted++) {
+      const uint32_t hash = hashAt(numInserted);
+      prev[numInserted] = head[hash];
+      head[hash] = static_cast<int>(numInserted);
+    }
+  };
+
+  // Longest earlier match of at least 3 bytes, 0 if none
+  auto findMatch = [&](size_t i, size_t &bestDistance) {
+    size_t bestLength = 0;
+    const size_t maxLength = size - i < 258 ? size - i : 258;
+
+    if (maxLength < 3)
+      return bestLength;
+
+    insertTo(i);
+    int candidate = prev[i];
+
+    for (int c = 0; c < maxChain && candidate >= 0; c++) {
+      const size_t distance = i - candidate;
+
+      if (distance > maxDistance)
+        break;
+
+      if (data[candidate + bestLength] == data[i + bestLength]) {
+        size_t length = 0;
+
+        while (length < maxLength &&
+               data[candidate + length] == data[i + length])
+          length++;
+
+        if (length > bestLength) {
+          bestLength = length;
+          bestDistance = distance;
+
+          if (length >= niceLength || length == maxLength)
+            break;
+        }
+      }
+
+      candidate = prev[candidate];
+    }
+
+    return bestLength >= 3 ? bestLength : 0;
+  };
+
+  auto flush = [&](bool last) {
+    WriteDynamicBlock(writer, symbols.data(), symbols.size(), last && final);
+    symbols.clear();
+  };
+
+  size_t i = 0;
+  size_t nextLength = 0, nextDistance = 0;
+  bool haveNext = false; // match at i was found by lookahead
+
+  while (i < size) {
+    if (symbols.size() >= blockSymbols)
+      flush(false);
+
+    size_t distance = nextDistance;
+    const size_t length = haveNext ? nextLength : findMatch(i, distance);
+    haveNext = false;
+
+    // Lazy matching, literal pays off when next position matches longer
+    if (length && length < niceLength && i + 1 < size) {
+      nextLength = findMatch(i + 1, nextDistance);
+      haveNext = nextLength > length;
+    }
+
+    if (!length || haveNext) {
+      symbols.push_back({data[i], 0});
+      i++;
+      continue;
+    }
+
+    symbols.push_back(
+        {static_cast<uint16_t>(length), static_cast<uint16_t>(distance)});
+    i += length;
+  }
+
+  flush(true);
+
+  if (!final) {
+    writer.Write(0, 3);
+    writer.Align();
+    const uchar emptyStored[] = {0, 0, 0xff, 0xff};
+    out.insert(out.end(), emptyStored, emptyStored + 4);
+  } else
+    writer.Align();
+}
+
+static uint32_t Adler32(const uchar *data, size_t size) {
+  const uint32_t base = 65521;
+  uint32_t a = 1, b = 0;
+
+  while (size) {
+    // Sums can't overflow within 5552 bytes
+    const size_t numBytes = size < 5552 ? size : 5552;
+
+    for (size_t i = 0; i < numBytes; i++) {
+      a += data[i];
+      b += a;
+    }
+
+    a %= base;
+    b %= base;
+    data += numBytes;
+    size -= numBytes;
+  }
+
+  return a | (b << 16);
+}
+
+// Same as zlib adler32_combine.
+static uint32_t Adler32Combine(uint32_t adler1, uint32_t adler2,
+                               size_t size2) {
+  const uint32_t base = 65521;
+  const uint32_t remainder = static_cast<uint32_t>(size2 % base);
+  uint32_t sum1 = adler1 & 0xffff;
+  uint32_t sum2 = (remainder * sum1) % base;
+  sum1 += (adler2 & 0xffff) + base - 1;
+  sum2 += (adler1 >> 16) + (adler2 >> 16) + base - remainder;
+
+  if (sum1 >= base)
+    sum1 -= base;
+  if (sum1 >= base)
+    sum1 -= base;
+  if (sum2 >= base << 1)
+    sum2 -= base << 1;
+  if (sum2 >= base)
+    sum2 -= base;
+
+  return sum1 | (sum2 << 16);
+}
+
+static uint32_t Crc32(const uchar *data, size_t size, uint32_t crc) {
+  const DeflateTables &tables = GetDeflateTables();
+
+  for (size_t i = 0; i < size; i++)
+    crc = tables.crc[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+  return crc;
+}
+
+static void WriteU32BE(std::vector<uchar> &out, uint32_t value) {
+  const uchar bytes[] = {
+      static_cast<uchar>(value >> 24), static_cast<uchar>(value >> 16),
+      static_cast<uchar>(value >> 8), static_cast<uchar>(value)};
+  out.insert(out.end(), bytes, bytes + 4);
+}
+
+static void WriteChunk(std::vector<uchar> &out, const char *type,
+                       const uchar *data, size_t size) {
+  WriteU32BE(out, static_cast<uint32_t>(size));
+  const size_t begin = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data, data + size);
+  WriteU32BE(out, Crc32(out.data() + begin, size + 4, 0xffffffff) ^
+                      0xffffffff);
+}
+
+static uchar Paeth(int left, int up, int upLeft) {
+  const int base = left + up - upLeft;
+  const int toLeft = std::abs(base - left);
+  const int toUp = std::abs(base - up);
+  const int toUpLeft = std::abs(base - upLeft);
+
+  if (toLeft <= toUp && toLeft <= toUpLeft)
+    return static_cast<uchar>(left);
+
+  return static_cast<uchar>(toUp <= toUpLeft ? up : upLeft);
+}
+
+// Residual of filter type 0 - 4 at byte i.
+static uchar Residual(int filter, const uchar *row, const uchar *prevRow,
+                      size_t i) {
+  const int left = i >= 4 ? row[i - 4] : 0;
+  const int up = prevRow ? prevRow[i] : 0;
+
+  switch (filter) {
+  case 1:
+    return static_cast<uchar>(row[i] - left);
+  case 2:
+    return static_cast<uchar>(row[i] - up);
+  case 3:
+    return static_cast<uchar>(row[i] - ((left + up) >> 1));
+  case 4:
+    return static_cast<uchar>(
+        row[i] - Paeth(left, up, i >= 4 && prevRow ? prevRow[i - 4] : 0));
+  default:
+    return row[i];
+  }
+}
+
+// Picks None, Sub or Up by smallest sum of signed residuals.
+static void FilterRow(const uchar *row, const uchar *prevRow, size_t size,
+                      uchar *out) {
+  uint32_t sums[3] = {};
+
+  for (size_t i = 0; i < size; i++) {
+    const uchar left = i >= 4 ? row[i - 4] : 0;
+    const uchar up = prevRow ? prevRow[i] : 0;
+    sums[0] += std::abs(static_cast<signed char>(row[i]));
+    sums[1] += std::abs(static_cast<signed char>(row[i] - left));
+    sums[2] += std::abs(static_cast<signed char>(row[i] - up));
+  }
+
+  int filter = sums[1] < sums[0] ? 1 : 0;
+
+  if (sums[2] < sums[filter])
+    filter = 2;
+
+  out[0] = static_cast<uchar>(filter);
+  out++;
+
+  switch (filter) {
+  case 0:
+    memcpy(out, row, size);
+    break;
+  case 1:
+    for (size_t i = 0; i < size; i++)
+      out[i] = row[i] - (i >= 4 ? row[i - 4] : 0);
+    break;
+  case 2:
+    for (size_t i = 0; i < size; i++)
+      out[i] = row[i] - (prevRow ? prevRow[i] : 0);
+    break;
+  }
+}
+
+// Same choice over all five filters.
+static void FilterRowMax(const uchar *row, const uchar *prevRow, size_t size,
+                         uchar *out) {
+  uint32_t sums[5] = {};
+
+  for (int f = 0; f < 5; f++)
+    for (size_t i = 0; i < size; i++)
+      sums[f] += std::abs(
+          static_cast<signed char>(Residual(f, row, prevRow, i)));
+
+  int filter = 0;
+
+  for (int f = 1; f < 5; f++)
+    if (sums[f] < sums[filter])
+      filter = f;
+
+  out[0] = static_cast<uchar>(filter);
+  out++;
+
+  for (size_t i = 0; i < size; i++)
+    out[i] = Residual(filter, row, prevRow, i);
+}
+
+std::vector<uchar> XenoEncodePNG(const uchar *rgba, int width, int height,
+                                 XenoPNGProfile profile,
+                                 XenoThreadPool *pool) {
+  const size_t stride = static_cast<size_t>(width) * 4;
+  // Strips of about 256 kB keep ratio close to single stream
+  const int rowsPerStrip =
+      stride < 0x40000 ? static_cast<int>(0x40000 / stride) : 1;
+  const int numStrips = (height + rowsPerStrip - 1) / rowsPerStrip;
+
+  struct Strip {
+    std::vector<uchar> chunk; // whole IDAT chunk
+    uint32_t adler;
+    size_t size;
+  };
+
+  std::vector<Strip> strips(numStrips);
+
+  auto encodeStrip = [&](int s) {
+    const int firstRow = s * rowsPerStrip;
+    const int numRows =
+        height - firstRow < rowsPerStrip ? height - firstRow : rowsPerStrip;
+    std::vector<uchar> filtered((stride + 1) * numRows);
+
+    for (int r = 0; r < numRows; r++) {
+      const int row = firstRow + r;
+      const uchar *rowData = rgba + stride * row;
+      const uchar *prevRow = row ? rowData - stride : nullptr;
+      uchar *outRow = filtered.data() + (stride + 1) * r;
+
+      if (profile == XenoPNG_Max)
+        FilterRowMax(rowData, prevRow, stride, outRow);
+      else
+        FilterRow(rowData, prevRow, stride, outRow);
+    }
+
+    Strip &strip = strips[s];
+    strip.size = filtered.size();
+    strip.adler = Adler32(filtered.data(), filtered.size());
+
+    std::vector<uchar> compressed;
+    compressed.reserve(filtered.size() / 2);
+
+    if (!s) {
+      // zlib header, deflate with 32k window, fastest or maximum level
+      compressed.push_back(0x78);
+      compressed.push_back(profile == XenoPNG_Max ? 0xda : 0x01);
+    }
+
+    if (profile == XenoPNG_Max)
+      DeflateMax(filtered.data(), filtered.size(), s == numStrips - 1,
+                 compressed);
+    else
+      Deflate(filtered.data(), filtered.size(), s == numStrips - 1,
+              compressed);
+    WriteChunk(strip.chunk, "IDAT", compressed.data(), compressed.size());
+  };
+
+  if (pool)
+    XenoParallelFor(*pool, numStrips, encodeStrip);
+  else
+    for (int s = 0; s < numStrips; s++)
+      encodeStrip(s);
+
+  std::vector<uchar> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  std::vector<uchar> header;
+  WriteU32BE(header, static_cast<uint32_t>(width));
+  WriteU32BE(header, static_cast<uint32_t>(height));
+  const uchar format[] = {8, 6, 0, 0, 0}; // 8 bit RGBA, no interlace
+  header.insert(header.end(), format, format + 5);
+  WriteChunk(out, "IHDR", header.data(), header.size());
+
+  uint32_t adler = 1;
+
+  for (auto &s : strips) {
+    out.insert(out.end(), s.chunk.begin(), s.chunk.end());
+    adler = Adler32Combine(adler, s.adler, s.size);
+  }
+
+  std::vector<uchar> checksum;
+  WriteU32BE(checksum, adler);
+  WriteChunk(out, "IDAT", checksum.data(), checksum.size());
+  WriteChunk(out, "IEND", nullptr, 0);
+
+  return out;
+}
+
+static bool GetDDSFormat(const uchar *header, size_t size,
+                         XenoBCFormat &format, size_t &dataOffset) {
+  if (size < 128 || memcmp(header, "DDS ", 4))
+    return false;
+
+  const uchar *fourCC = header + 84;
+  dataOffset = 128;
+
+  if (!memcmp(fourCC, "DXT1", 4))
+    format = XenoBC1;
+  else if (!memcmp(fourCC, "DXT3", 4))
+    format = XenoBC2;
+  else if (!memcmp(fourCC, "DXT5", 4))
+    format = XenoBC3;
+  else if (!memcmp(fourCC, "ATI1", 4) || !memcmp(fourCC, "BC4U", 4))
+    format = XenoBC4;
+  else if (!memcmp(fourCC, "ATI2", 4) || !memcmp(fourCC, "BC5U", 4))
+    format = XenoBC5;
+  else if (!memcmp(fourCC, "DX10", 4) && size >= 148) {
+    dataOffset = 148;
+
+    switch (ReadU32(header + 128)) {
+    case 70: // BC1 typeless, unorm, srgb
+    case 71:
+    case 72:
+      format = XenoBC1;
+      break;
+    case 73:
+    case 74:
+    case 75:
+      format = XenoBC2;
+      break;
+    case 76:
+    case 77:
+    case 78:
+      format = XenoBC3;
+      break;
+    case 79: // BC4, BC5 typeless, unorm
+    case 80:
+      format = XenoBC4;
+      break;
+    case 82:
+    case 83:
+      format = XenoBC5;
+      break;
+    default:
+      return false;
+    }
+  } else
+    return false;
+
+  return true;
+}
+
+bool XenoDecodeDDS(const std::vector<uchar> &dds, bool reconstructZ,
+                   XenoThreadPool *pool, std::vector<uchar> &rgba, int &width,
+                   int &height, XenoBCFormat &format) {
+  size_t dataOffset;
+
+  if (!GetDDSFormat(dds.data(), dds.size(), format, dataOffset))
+    return false;
+
+  height = static_cast<int>(ReadU32(dds.data() + 12));
+  width = static_cast<int>(ReadU32(dds.data() + 16));
+  const size_t dataSize = static_cast<size_t>((width + 3) / 4) *
+                          ((height + 3) / 4) * XenoBCBlockSize(format);
+
+  if (width <= 0 || height <= 0 || dds.size() - dataOffset < dataSize)
+    return false;
+
+  rgba.resize(static_cast<size_t>(width) * height * 4);
+  XenoDecodeBC(format, dds.data() + dataOffset, width, height, rgba.data(),
+               reconstructZ, pool);
+
+  return true;
+}
+
+bool XenoConvertDDSToPNG(const TSTRING &ddsPath, const TSTRING &pngPath,
+                         bool reconstructZ, XenoPNGProfile profile,
+                         XenoThreadPool *pool) {
+  std::ifstream inStream(ddsPath.c_str(), std::ios::binary);
+
+  if (!inStream)
+    return false;
+
+  const std::vector<uchar> dds((std::istreambuf_iterator<char>(inStream)),
+                               std::istreambuf_iterator<char>());
+  std::vector<uchar> rgba;
+  int width, height;
+  XenoBCFormat format;
+
+  if (!XenoDecodeDDS(dds, reconstructZ, pool, rgba, width, height, format))
+    return false;
+
+  const std::vector<uchar> png =
+      XenoEncodePNG(rgba.data(), width, height, profile, pool);
+  std::ofstream outStream(pngPath.c_str(), std::ios::binary);
+  outStream.write(reinterpret_cast<const char *>(png.data()), png.size());
+
+  return static_cast<bool>(outStream);
+}
@@ -0,0 +1,53 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// RGBA8 PNG encoder for extracted textures.
+// Fast profile filters rows with None, Sub or Up and compresses by greedy
+// LZ77 with fixed Huffman codes. Max profile tries all five filters and
+// compresses by lazy matching over hash chains into dynamic Huffman blocks.
+// Rows are compressed in strips, that are independent deflate blocks in
+// separate IDAT chunks, so they are encoded in parallel.
+
+#pragma once
+#include "MXMD.h"
+#include "XenoBCn.h"
+#include <vector>
+
+class XenoThreadPool;
+
+enum XenoPNGProfile {
+  XenoPNG_Max,  // maximum compression
+  XenoPNG_Fast, // fastest encoding
+};
+
+// Encodes tightly packed RGBA8 image, pool can be nullptr for calling thread.
+// Output doesn't depend on pool.
+std::vector<uchar> XenoEncodePNG(const uchar *rgba, int width, int height,
+                                 XenoPNGProfile profile,
+                                 XenoThreadPool *pool);
+
+// Decodes top level of BC1-BC5 .dds file data into tightly packed RGBA8.
+// False when format is not supported or data is truncated.
+bool XenoDecodeDDS(const std::vector<uchar> &dds, bool reconstructZ,
+                   XenoThreadPool *pool, std::vector<uchar> &rgba, int &width,
+                   int &height, XenoBCFormat &format);
+
+// Converts top level of BC1-BC5 .dds into .png by XenoDecodeBC and
+// XenoEncodePNG. False when format is not supported or file is unreadable.
+bool XenoConvertDDSToPNG(const TSTRING &ddsPath, const TSTRING &pngPath,
+                         bool reconstructZ, XenoPNGProfile profile,
+                         XenoThreadPool *pool);
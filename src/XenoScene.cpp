@@ -0,0 +1,1121 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "XenoScene.h"
+#include "XenoAnim.h"
+#include "XenoDecode.h"
+#include "XenoTexCache.h"
+#include "XenoThreads.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <sys/stat.h>
+#include <unordered_map>
+
+#include "datas/esstring.h"
+#include "datas/fileinfo.hpp"
+
+// Copies index buffer into mesh faces and builds compaction remap of
+// referenced vertices, in single pass over index buffer.
+// Returns number of referenced vertices, remap is -1 for isolated ones.
+static int BuildFaces(XenoMeshBuffers &mesh, const USVector *fBuff,
+                      int numFaces, int numVerts, std::vector<int> &remap) {
+  remap.assign(numVerts, -1);
+  mesh.faces.resize(numFaces);
+  USVector *faces = mesh.faces.data();
+
+  for (int f = 0; f < numFaces; f++) {
+    const USVector face = fBuff[f];
+    faces[f] = face;
+    remap[face.X] = 0;
+    remap[face.Y] = 0;
+    remap[face.Z] = 0;
+  }
+
+  int numUsed = 0;
+
+  for (auto &r : remap)
+    if (!r)
+      r = numUsed++;
+
+  if (numUsed != numVerts)
+    for (auto &f : mesh.faces) {
+      f.X = static_cast<ushort>(remap[f.X]);
+      f.Y = static_cast<ushort>(remap[f.Y]);
+      f.Z = static_cast<ushort>(remap[f.Z]);
+    }
+
+  return numUsed;
+}
+
+// Drops isolated vertices from all per vertex arrays.
+static void CompactMesh(XenoMeshBuffers &mesh, const std::vector<int> &remap,
+                        int numUsed) {
+  const int numVerts = static_cast<int>(remap.size());
+
+  if (numUsed == numVerts)
+    return;
+
+  auto compact = [&](auto &arr) {
+    if (arr.size() != static_cast<size_t>(numVerts))
+      return;
+
+    for (int v = 0; v < numVerts; v++)
+      if (remap[v] > -1)
+        arr[remap[v]] = arr[v];
+
+    arr.resize(numUsed);
+  };
+
+  compact(mesh.positions);
+  compact(mesh.normals);
+  compact(mesh.weightIDs);
+
+  for (auto &m : mesh.maps)
+    compact(m.verts);
+}
+
+// Face corners are resolved once into remap, shared by all targets.
+// Only referenced, non zero deltas are kept, so target is O(deltas).
+static void DecodeMorphTarget(MXMDMorphTargets::Ptr &morphs,
+                              MXMDModel::Ptr &mdl, int targetID,
+                              const std::vector<int> &remap,
+                              XenoMorphTarget &target) {
+  const int numVerts = static_cast<int>(remap.size());
+  MXMDVertexBuffer::DescriptorCollection morph =
+      morphs->GetDeltaMorph(targetID);
+  const char *morphName =
+      mdl->GetMorphName(morphs->GetMorphNameID(targetID));
+  std::vector<int> IDS;
+
+  if (morphName)
+    target.name = morphName;
+
+  for (auto &d : morph)
+    switch (d->Type()) {
+    case MXMD_MORPHVERTEXID: {
+      const int numItems = d->Size();
+      IDS.resize(numItems);
+      XenoDecodeAttribute(d.get(),
+                          XenoSelectDecoder(d.get(), XenoAttr_MorphID), 0,
+                          numItems, IDS.data());
+      break;
+    }
+    case MXMD_POSITION: {
+      const int numItems = static_cast<int>(IDS.size());
+      std::vector<Vector> deltas(numItems);
+      XenoDecodeAttribute(d.get(),
+                          XenoSelectDecoder(d.get(), XenoAttr_Position), 0,
+                          numItems, deltas.data());
+      XenoRemapMorphDeltas(IDS.data(), deltas.data(), numItems, remap.data(),
+                           numVerts, target.indices, target.deltas);
+      XenoTransformPositions(target.deltas.data(),
+                             static_cast<int>(target.deltas.size()), 1.f);
+      break;
+    }
+    default:
+      break;
+    }
+
+  target.indices.shrink_to_fit();
+  target.deltas.shrink_to_fit();
+}
+
+// Decodes everything but morph targets, those are decoded per target by
+// DecodeMorphTarget, with returned remap and morphs.
+static void DecodeMeshBuffers(MXMDGeomBuffers::Ptr &geom, int bufferID,
+                              int facesID, const XenoSettings &settings,
+                              XenoMeshBuffers &mesh, std::vector<int> &remap,
+                              MXMDMorphTargets::Ptr &morphs) {
+  MXMDFaceBuffer::Ptr fBuffer = geom->GetFaceBuffer(facesID);
+  MXMDVertexBuffer::Ptr vBuffer = geom->GetVertexBuffer(bufferID);
+  const int numVerts = vBuffer->NumVertices();
+  const int numFaces = fBuffer->GetNumIndices() / 3;
+  const USVector *fBuff = fBuffer->GetBuffer();
+  MXMDVertexBuffer::DescriptorCollection descs = vBuffer->GetDescriptors();
+  MXMDVertexDescriptor *skinDesc = nullptr;
+  MXMDVertexDescriptor *positionDesc = nullptr;
+  MXMDVertexDescriptor *normalDesc = nullptr;
+  int currentMap = 1;
+
+  for (auto &d : descs)
+    switch (d->Type()) {
+    case MXMD_POSITION:
+      positionDesc = d.get();
+      break;
+    case MXMD_UV1:
+    case MXMD_UV2:
+    case MXMD_UV3: {
+      XenoMapChannel chan;
+      chan.mapID = currentMap++;
+      chan.verts.resize(numVerts);
+      XenoDecodeAttribute(d.get(), XenoSelectDecoder(d.get(), XenoAttr_UV),
+                          0, numVerts, chan.verts.data());
+
+      mesh.maps.push_back(std::move(chan));
+      break;
+    }
+    case MXMD_NORMAL:
+    case MXMD_NORMAL2:
+    case MXMD_NORMAL32:
+      normalDesc = d.get();
+      break;
+    case MXMD_VERTEXCOLOR: {
+      XenoMapChannel color, alpha;
+      color.mapID = 0;
+      alpha.mapID = -2;
+      color.verts.resize(numVerts);
+      alpha.verts.resize(numVerts);
+      std::vector<Vector4> colors(numVerts);
+      XenoDecodeAttribute(d.get(),
+                          XenoSelectDecoder(d.get(), XenoAttr_Color), 0,
+                          numVerts, colors.data());
+
+      for (int v = 0; v < numVerts; v++) {
+        const Vector4 &temp = colors[v];
+        color.verts[v] = Vector(temp.X, temp.Y, temp.Z);
+        alpha.verts[v] = Vector(temp.W, temp.W, temp.W);
+      }
+
+      mesh.maps.push_back(std::move(color));
+      mesh.maps.push_back(std::move(alpha));
+      break;
+    }
+    case MXMD_WEIGHTID:
+      skinDesc = d.get();
+      break;
+    default:
+      break;
+    }
+
+  morphs = geom->GetVertexBufferMorphTargets(bufferID);
+  mesh.hasMorphs = morphs != nullptr;
+  MXMDVertexBuffer::DescriptorCollection morphDescs;
+
+  // Base morph overrides vertex buffer, decode only what's final
+  if (morphs) {
+    morphDescs = morphs->GetBaseMorph();
+
+    for (auto &d : morphDescs)
+      switch (d->Type()) {
+      case MXMD_POSITION:
+        positionDesc = d.get();
+        break;
+      case MXMD_NORMALMORPH:
+        normalDesc = d.get();
+        break;
+      default:
+        break;
+      }
+  }
+
+  if (positionDesc) {
+    mesh.positions.resize(numVerts);
+    XenoDecodePositions(positionDesc, 0, numVerts, mesh.positions.data(),
+                        settings.scale);
+  }
+
+  if (normalDesc) {
+    mesh.normals.resize(numVerts);
+    XenoDecodeNormals(normalDesc, numVerts, mesh.normals.data());
+  }
+
+  const int numUsedVerts =
+      BuildFaces(mesh, fBuff, numFaces, numVerts, remap);
+
+  if (skinDesc) {
+    mesh.weightIDs.resize(numVerts);
+    XenoDecodeAttribute(skinDesc,
+                        XenoSelectDecoder(skinDesc, XenoAttr_WeightID), 0,
+                        numVerts, mesh.weightIDs.data());
+  }
+
+  if (morphs)
+    mesh.morphs.resize(morphs->GetNumMorphs());
+
+  CompactMesh(mesh, remap, numUsedVerts);
+
+  mesh.numWeightEntries =
+      mesh.weightIDs.size()
+          ? *std::max_element(mesh.weightIDs.begin(), mesh.weightIDs.end()) + 1
+          : 0;
+}
+
+namespace {
+struct InfluenceKey {
+  XenoVertexWeight weight;
+
+  bool operator==(const InfluenceKey &o) const {
+    return !memcmp(&weight, &o.weight, sizeof(weight));
+  }
+};
+
+struct InfluenceHash {
+  size_t operator()(const InfluenceKey &key) const {
+    size_t hash = 0;
+    const int *data = reinterpret_cast<const int *>(&key.weight);
+
+    for (size_t i = 0; i < sizeof(key.weight) / sizeof(int); i++)
+      hash = hash * 31 + std::hash<int>()(data[i]);
+
+    return hash;
+  }
+};
+} // namespace
+
+// Weight palette depends on LOD and skin descriptor of mesh object.
+static int GetSkinDesc(MXMDMeshObject::Ptr &mObj) {
+  return ((mObj->GetLODID() << 8) & 0xff00) | (mObj->GetSkinDesc() & 0xff);
+}
+
+static void DecodeWeightPalette(MXMDGeomBuffers::Ptr &geom, int skinDesc,
+                                int numEntries, XenoWeightPalette &palette) {
+  MXMDGeomVertexWeightBuffer::Ptr wtBuff = geom->GetWeightsBuffer(skinDesc);
+
+  if (!wtBuff)
+    return;
+
+  for (int u = 0; u < 4; u++) {
+    palette.boneids[u].resize(numEntries);
+    palette.weights[u].resize(numEntries);
+  }
+
+  for (int e = 0; e < numEntries; e++) {
+    MXMDVertexWeight cWtOut = wtBuff->GetVertexWeight(e);
+
+    for (int u = 0; u < 4; u++) {
+      palette.boneids[u][e] = cWtOut.boneids[u];
+      palette.weights[u][e] = cWtOut.weights[u];
+    }
+  }
+}
+
+// Influence sets are built once per referenced palette entry, deduplicated
+// by content and then gathered per vertex.
+static void ResolveWeights(const XenoWeightPalette &palette, XenoMesh &mesh) {
+  const std::vector<ushort> &weightIDs = mesh.buffers->weightIDs;
+  const int numEntries = mesh.buffers->numWeightEntries;
+
+  if (!weightIDs.size() || palette.Size() < numEntries)
+    return;
+
+  XenoSkin &skin = mesh.skin;
+  const int numVerts = static_cast<int>(weightIDs.size());
+  std::vector<int> entrySets(numEntries, -1);
+  std::unordered_map<InfluenceKey, int, InfluenceHash> uniqueSets;
+  std::vector<bool> usedBones;
+
+  for (auto &w : weightIDs)
+    entrySets[w] = 0;
+
+  skin.setOffsets.assign(1, 0);
+
+  for (int e = 0; e < numEntries; e++) {
+    int &setID = entrySets[e];
+
+    if (setID < 0)
+      continue;
+
+    InfluenceKey key = {};
+    int numInfluences = 0;
+
+    for (int u = 0; u < 4; u++) {
+      const float weight = palette.weights[u][e];
+
+      if (weight == 0.f)
+        continue;
+
+      key.weight.boneids[numInfluences] = palette.boneids[u][e];
+      key.weight.weights[numInfluences++] = weight;
+    }
+
+    auto found = uniqueSets.find(key);
+
+    if (found != uniqueSets.end()) {
+      setID = found->second;
+      continue;
+    }
+
+    setID = static_cast<int>(uniqueSets.size());
+    uniqueSets[key] = setID;
+
+    for (int u = 0; u < numInfluences; u++) {
+      const int boneID = key.weight.boneids[u];
+
+      if (static_cast<size_t>(boneID) >= usedBones.size())
+        usedBones.resize(boneID + 1);
+
+      usedBones[boneID] = true;
+      skin.setBones.push_back(boneID);
+      skin.setWeights.push_back(key.weight.weights[u]);
+    }
+
+    skin.setOffsets.push_back(static_cast<int>(skin.setBones.size()));
+  }
+
+  skin.vertexSets.resize(numVerts);
+  XenoGatherIndices(entrySets.data(), weightIDs.data(), numVerts,
+                    skin.vertexSets.data());
+
+  std::vector<int> boneSlots(usedBones.size(), -1);
+
+  for (size_t b = 0; b < usedBones.size(); b++)
+    if (usedBones[b]) {
+      boneSlots[b] = static_cast<int>(skin.usedBones.size());
+      skin.usedBones.push_back(static_cast<int>(b));
+    }
+
+  for (auto &b : skin.setBones)
+    b = boneSlots[b];
+}
+
+// Mesh objects with LOD 0 aren't part of any LOD chain and are always used.
+static bool UseMeshLOD(int meshLOD, int LOD, bool withCommon) {
+  if (!meshLOD)
+    return withCommon;
+
+  return LOD < 0 || meshLOD == LOD;
+}
+
+std::mutex &XenoStreamMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+static MXMDGeomBuffers::Ptr GetGeometry(MXMD *model, int group) {
+  std::lock_guard<std::mutex> lock(XenoStreamMutex());
+  return model->GetGeometry(group);
+}
+
+int XenoSelectLOD(MXMD *model, MXMDModel::Ptr &mdl, int curGroup,
+                  const XenoSettings &settings) {
+  if (settings.LODPolicy == XenoLOD_All)
+    return -1;
+
+  MXMDGeomBuffers::Ptr geom = GetGeometry(model, curGroup);
+
+  if (!geom)
+    return -1;
+
+  MXMDMeshGroup::Ptr group = mdl->GetMeshGroup(curGroup);
+  const int numMeshes = group->GetNumMeshObjects();
+  std::map<int, size_t> numLODTris;
+
+  for (int m = 0; m < numMeshes; m++) {
+    MXMDMeshObject::Ptr mObj = group->GetMeshObject(m);
+    MXMDFaceBuffer::Ptr fBuffer = geom->GetFaceBuffer(mObj->GetUVFacesID());
+    numLODTris[mObj->GetLODID()] += fBuffer->GetNumIndices() / 3;
+  }
+
+  const size_t numCommonTris = numLODTris[0];
+  numLODTris.erase(0);
+
+  if (!numLODTris.size())
+    return -1;
+
+  // Levels are ordered from the finest one
+  if (settings.LODPolicy == XenoLOD_Base)
+    return numLODTris.begin()->first;
+
+  for (auto &l : numLODTris)
+    if (numCommonTris + l.second <= static_cast<size_t>(settings.LODBudget))
+      return l.first;
+
+  return numLODTris.rbegin()->first;
+}
+
+// LODs per group, -1 for every level.
+static std::vector<std::vector<XenoMesh>>
+DecodeGroups(MXMD *model, MXMDModel::Ptr &mdl, const std::vector<int> &groups,
+             const std::vector<int> &LODs, bool withCommon,
+             const XenoSettings &settings, XenoThreadPool &pool,
+             XenoMeshCache &cache) {
+  struct BufferJob {
+    MXMDGeomBuffers::Ptr geom;
+    XenoMeshCache::Key key;
+    std::shared_ptr<XenoMeshBuffers> buffers;
+    std::vector<int> remap;
+    MXMDMorphTargets::Ptr morphs;
+  };
+
+  struct MorphJob {
+    BufferJob *buffer;
+    int targetID;
+  };
+
+  struct MeshJob {
+    MXMDGeomBuffers::Ptr geom;
+    MXMDMeshObject::Ptr mObj;
+    XenoMesh *mesh;
+    std::shared_ptr<const XenoWeightPalette> palette;
+  };
+
+  struct PaletteJob {
+    MXMDGeomBuffers::Ptr geom;
+    int skinDesc;
+    int numEntries;
+    std::shared_ptr<XenoWeightPalette> palette;
+  };
+
+  const int numGroups = static_cast<int>(groups.size());
+  std::vector<std::vector<XenoMesh>> outGroups(numGroups);
+  std::vector<BufferJob> bufferJobs;
+  std::vector<MeshJob> jobs;
+
+  // Gather every mesh object first, so groups overlap on pool.
+  // Buffers are looked up here, so each missing pair is decoded only once.
+  for (int g = 0; g < numGroups; g++) {
+    const int curGroup = groups[g];
+    MXMDGeomBuffers::Ptr geom = GetGeometry(model, curGroup);
+
+    if (!geom)
+      continue;
+
+    MXMDMeshGroup::Ptr group = mdl->GetMeshGroup(curGroup);
+    const int numMeshes = group->GetNumMeshObjects();
+    std::vector<XenoMesh> &outMeshes = outGroups[g];
+    std::vector<MXMDMeshObject::Ptr> usedObjects;
+    int currentMesh = 0;
+
+    // Names are given by whole group, so skipped LODs won't shift them
+    for (int m = 0; m < numMeshes; m++) {
+      MXMDMeshObject::Ptr mObj = group->GetMeshObject(m);
+      const int gibid = mObj->GetGibID();
+      std::string name = gibid ? "Part" + std::to_string(gibid)
+                               : "Object" + std::to_string(currentMesh++);
+
+      if (!UseMeshLOD(mObj->GetLODID(), LODs[g], withCommon))
+        continue;
+
+      XenoMesh mesh = {};
+      mesh.name = std::move(name);
+      outMeshes.push_back(std::move(mesh));
+      usedObjects.push_back(mObj);
+    }
+
+    for (size_t m = 0; m < usedObjects.size(); m++) {
+      MXMDMeshObject::Ptr &mObj = usedObjects[m];
+      XenoMesh &mesh = outMeshes[m];
+      const XenoMeshCache::Key key = {curGroup, mObj->GetBufferID(),
+                                      mObj->GetUVFacesID()};
+      auto found = cache.entries.find(key);
+
+      if (found != cache.entries.end()) {
+        cache.hits++;
+        mesh.buffers = found->second;
+      } else {
+        cache.misses++;
+        auto buffers = std::make_shared<XenoMeshBuffers>();
+        cache.entries[key] = buffers;
+        mesh.buffers = buffers;
+        bufferJobs.push_back({geom, key, buffers, {}, nullptr});
+      }
+
+      mesh.group = curGroup;
+      mesh.LOD = mObj->GetLODID();
+      mesh.materialID = mObj->GetMaterialID();
+      jobs.push_back({geom, mObj, &mesh, nullptr});
+    }
+  }
+
+  XenoParallelFor(pool, static_cast<int>(bufferJobs.size()), [&](int j) {
+    BufferJob &job = bufferJobs[j];
+    DecodeMeshBuffers(job.geom, job.key.bufferID, job.key.facesID, settings,
+                      *job.buffers, job.remap, job.morphs);
+  });
+
+  // Heavy face rigs have dozens of targets per buffer, spread them too
+  std::vector<MorphJob> morphJobs;
+
+  for (auto &b : bufferJobs)
+    for (size_t t = 0; t < b.buffers->morphs.size(); t++)
+      morphJobs.push_back({&b, static_cast<int>(t)});
+
+  XenoParallelFor(pool, static_cast<int>(morphJobs.size()), [&](int j) {
+    MorphJob &job = morphJobs[j];
+    BufferJob &buffer = *job.buffer;
+    DecodeMorphTarget(buffer.morphs, mdl, job.targetID, buffer.remap,
+                      buffer.buffers->morphs[job.targetID]);
+  });
+
+  for (auto &b : bufferJobs) {
+    auto &targets = b.buffers->morphs;
+    targets.erase(std::remove_if(targets.begin(), targets.end(),
+                                 [](const XenoMorphTarget &t) {
+                                   return !t.indices.size();
+                                 }),
+                  targets.end());
+    std::vector<int>().swap(b.remap);
+  }
+
+  // Palettes are shared by every object with same skin descriptor, find
+  // out how many entries each one needs and decode missing ones once.
+  std::map<XenoMeshCache::PaletteKey, int> paletteSizes;
+  std::map<XenoMeshCache::PaletteKey, int> paletteUsers;
+
+  for (auto &j : jobs) {
+    const int numEntries = j.mesh->buffers->numWeightEntries;
+
+    if (!numEntries)
+      continue;
+
+    const XenoMeshCache::PaletteKey key(j.mesh->group, GetSkinDesc(j.mObj));
+    int &size = paletteSizes[key];
+    size = std::max(size, numEntries);
+    paletteUsers[key]++;
+  }
+
+  std::vector<PaletteJob> paletteJobs;
+
+  for (auto &p : paletteSizes) {
+    auto found = cache.palettes.find(p.first);
+    const size_t numUsers = paletteUsers[p.first];
+
+    if (found != cache.palettes.end() && found->second->Size() >= p.second) {
+      cache.paletteHits += numUsers;
+      continue;
+    }
+
+    cache.paletteMisses++;
+    cache.paletteHits += numUsers - 1;
+    auto palette = std::make_shared<XenoWeightPalette>();
+    cache.palettes[p.first] = palette;
+    paletteJobs.push_back({GetGeometry(model, p.first.first), p.first.second,
+                           p.second, palette});
+  }
+
+  XenoParallelFor(pool, static_cast<int>(paletteJobs.size()), [&](int j) {
+    PaletteJob &job = paletteJobs[j];
+    DecodeWeightPalette(job.geom, job.skinDesc, job.numEntries, *job.palette);
+  });
+
+  for (auto &j : jobs)
+    if (j.mesh->buffers->numWeightEntries)
+      j.palette = cache.palettes[XenoMeshCache::PaletteKey(
+          j.mesh->group, GetSkinDesc(j.mObj))];
+
+  XenoParallelFor(pool, static_cast<int>(jobs.size()), [&](int j) {
+    MeshJob &job = jobs[j];
+
+    if (job.palette)
+      ResolveWeights(*job.palette, *job.mesh);
+  });
+
+  return outGroups;
+}
+
+std::vector<std::vector<XenoMesh>>
+XenoDecodeMeshGroups(MXMD *model, MXMDModel::Ptr &mdl,
+                     const std::vector<int> &groups,
+                     const XenoSettings &settings, XenoThreadPool &pool,
+                     XenoMeshCache &cache) {
+  std::vector<int> LODs;
+
+  for (auto &g : groups)
+    LODs.push_back(XenoSelectLOD(model, mdl, g, settings));
+
+  return DecodeGroups(model, mdl, groups, LODs, true, settings, pool, cache);
+}
+
+std::vector<XenoMesh> XenoDecodeMeshLOD(MXMD *model, MXMDModel::Ptr &mdl,
+                                        int curGroup, int LOD,
+                                        const XenoSettings &settings,
+                                        XenoThreadPool &pool,
+                                        XenoMeshCache &cache) {
+  return std::move(DecodeGroups(model, mdl, {curGroup}, {LOD}, false,
+                                settings, pool, cache)[0]);
+}
+
+static XenoMatrix ToXenoMatrix(const MXMDTransformMatrix *mtx, float scale) {
+  XenoMatrix retval;
+
+  for (int r = 0; r < 4; r++)
+    retval.r[r] = Vector(mtx->m[r].X, mtx->m[r].Y, mtx->m[r].Z);
+
+  retval.r[3] *= scale;
+
+  return retval;
+}
+
+std::vector<XenoPoseBone> XenoDecodeModelPose(MXMDModel::Ptr &model,
+                                              const XenoSettings &settings) {
+  const int numBones = model->GetNumSkinBones();
+  std::vector<XenoPoseBone> bones(numBones);
+
+  for (int b = 0; b < numBones; b++) {
+    MXMDBone::Ptr cBone = model->GetSkinBone(b);
+    XenoPoseBone &bone = bones[b];
+    bone.name = cBone->GetName();
+    bone.bindTM = ToXenoMatrix(cBone->GetAbsTransform(), settings.scale);
+
+    const int parentID = cBone->GetParentID();
+
+    if (parentID > -1)
+      bone.parentName = model->GetBone(parentID)->GetName();
+  }
+
+  return bones;
+}
+
+std::vector<XenoBone> XenoDecodeSkeleton(BCSKEL *skel,
+                                         const XenoSettings &settings) {
+  BCSKEL::BoneData *boneData = skel->boneData.ptr;
+  const int numBones = boneData->boneLinks.count;
+  std::vector<XenoBone> bones(numBones);
+
+  for (int b = 0; b < numBones; b++) {
+    BCSKEL::BoneTransform &boneTM = boneData->boneTransforms.data[b];
+    XenoBone &bone = bones[b];
+    bone.name = boneData->boneNames.data[b].name;
+    bone.parentID = boneData->boneLinks.data[b];
+    bone.rotation = reinterpret_cast<const Vector4 &>(boneTM.rotation);
+    bone.position = reinterpret_cast<const Vector &>(boneTM.position) *
+                    settings.scale;
+    bone.scale = reinterpret_cast<const Vector &>(boneTM.scale);
+  }
+
+  return bones;
+}
+
+std::vector<XenoInstance> XenoDecodeInstances(MXMD *model,
+                                              const XenoSettings &settings) {
+  MXMDInstances::Ptr insts = model->GetInstances();
+
+  if (!insts)
+    return {};
+
+  const int numInstances = insts->GetNumInstances();
+  std::vector<XenoInstance> instances(numInstances);
+
+  for (int i = 0; i < numInstances; i++) {
+    XenoInstance &inst = instances[i];
+    inst.transform = ToXenoMatrix(insts->GetTransform(i), settings.scale);
+
+    const int groupBegin = insts->GetStartingGroup(i);
+    const int groupEnd = groupBegin + insts->GetNumGroups(i);
+
+    for (int g = groupBegin; g < groupEnd; g++)
+      inst.groups.push_back(insts->GetMeshGroup(g));
+  }
+
+  return instances;
+}
+
+std::vector<float> XenoFrameGrid(BCANIM *anim, float frameRate) {
+  const float duration = anim->frameTime * anim->frameCount;
+  const float numFramesRaw = duration * frameRate;
+  int numFrames = static_cast<int>(numFramesRaw);
+
+  if (numFramesRaw - numFrames > 0.5f)
+    numFrames++;
+
+  std::vector<float> frameTimes(numFrames);
+
+  for (int f = 0; f < numFrames; f++)
+    frameTimes[f] = f / frameRate;
+
+  return frameTimes;
+}
+
+XenoTransform XenoAnimTrack::GetFrame(int frame) const {
+  XenoTransform retval;
+  retval.position = Vector(position[0][frame], position[1][frame],
+                           position[2][frame]);
+  retval.rotation = Vector4(rotation[0][frame], rotation[1][frame],
+                            rotation[2][frame], rotation[3][frame]);
+  retval.scale = Vector(scale[0][frame], scale[1][frame], scale[2][frame]);
+
+  return retval;
+}
+
+// Evaluates track at every time into position xyz, rotation xyzw, scale xyz
+// component arrays, position is scaled.
+static void EvaluateTrack(BCANIM *anim, BCANIM::Track &animTrack,
+                          const float *times, int numTimes, float scale,
+                          float *const out[10]) {
+  for (int i = 0; i < numTimes; i++) {
+    BCANIM::TransformFrame evalTransform;
+    animTrack.GetTransform(times[i], evalTransform, anim);
+
+    const Vector &position = reinterpret_cast<Vector &>(evalTransform.position);
+    const Vector4 &rotation =
+        reinterpret_cast<Vector4 &>(evalTransform.rotation);
+    const Vector &tScale = reinterpret_cast<Vector &>(evalTransform.scale);
+
+    for (int c = 0; c < 3; c++) {
+      out[c][i] = position[c] * scale;
+      out[7 + c][i] = tScale[c];
+    }
+
+    for (int c = 0; c < 4; c++)
+      out[3 + c][i] = rotation[c];
+  }
+}
+
+static bool NearlyEqual(float a, float b) {
+  return fabsf(a - b) <= 1e-4f * std::max(1.f, fabsf(a));
+}
+
+// Tracks are evaluated only at source frames, host frames are then
+// interpolated from them over grid shared by all tracks. Frames between
+// source frames are spot checked against GetTransform, track that doesn't
+// interpolate linearly is evaluated at every host frame instead, so are
+// tracks baked after it.
+// Tracks are independent, every one is baked as separate job.
+XenoAnimation XenoBakeAnimation(BCANIM *anim,
+                                const std::vector<float> &frameTimes,
+                                const XenoSettings &settings,
+                                XenoThreadPool &pool) {
+  XenoAnimation retval;
+  retval.frameTimes = frameTimes;
+
+  const int numAniBones = anim->animData->boneCount;
+  const int numFrames = static_cast<int>(frameTimes.size());
+  const int numSamples = anim->frameCount + 1;
+  // Sparser host grid is cheaper to evaluate directly
+  const bool resample = numSamples < numFrames;
+  XenoSampleGrid grid;
+  std::vector<float> sampleTimes;
+  std::vector<int> checkFrames;
+
+  if (resample) {
+    grid = XenoBuildSampleGrid(frameTimes, anim->frameTime, numSamples);
+    sampleTimes.resize(numSamples);
+
+    for (int i = 0; i < numSamples; i++)
+      sampleTimes[i] = i * anim->frameTime;
+
+    std::vector<int> blended;
+
+    for (int f = 0; f < numFrames; f++)
+      if (grid.weights[f] > 0.f)
+        blended.push_back(f);
+
+    const int numBlended = static_cast<int>(blended.size());
+    const int numChecks = std::min(numBlended, 4);
+
+    // Middle of every quarter
+    for (int c = 0; c < numChecks; c++)
+      checkFrames.push_back(
+          blended[(2 * c + 1) * numBlended / (2 * numChecks)]);
+  }
+
+  std::atomic<bool> linearTracks(true);
+  std::vector<int> trackIDs;
+
+  for (int a = 0; a < numAniBones; a++)
+    if (anim->animData->boneTableOffset[a] >= 0) {
+      XenoAnimTrack track;
+      track.boneID = a;
+      trackIDs.push_back(anim->animData->boneTableOffset[a]);
+      retval.tracks.push_back(std::move(track));
+    }
+
+  XenoParallelFor(pool, static_cast<int>(trackIDs.size()), [&](int t) {
+    XenoAnimTrack &track = retval.tracks[t];
+    BCANIM::Track &animTrack = anim->tracks.data[trackIDs[t]];
+    float *frames[10];
+    float *const *rotationFrames = frames + 3;
+
+    for (int c = 0; c < 3; c++) {
+      track.position[c].resize(numFrames);
+      track.scale[c].resize(numFrames);
+      frames[c] = track.position[c].data();
+      frames[7 + c] = track.scale[c].data();
+    }
+
+    for (int c = 0; c < 4; c++) {
+      track.rotation[c].resize(numFrames);
+      frames[3 + c] = track.rotation[c].data();
+    }
+
+    bool evaluate = !resample || !linearTracks;
+
+    if (!evaluate) {
+      std::vector<float> samples[10];
+      float *sampleData[10];
+
+      for (int c = 0; c < 10; c++) {
+        samples[c].resize(numSamples);
+        sampleData[c] = samples[c].data();
+      }
+
+      EvaluateTrack(anim, animTrack, sampleTimes.data(), numSamples,
+                    settings.scale, sampleData);
+      XenoResampleRotation(sampleData + 3, grid, frames + 3);
+
+      for (int c = 0; c < 3; c++) {
+        XenoResampleLinear(sampleData[c], grid, frames[c]);
+        XenoResampleLinear(sampleData[7 + c], grid, frames[7 + c]);
+      }
+
+      for (int f : checkFrames) {
+        float check[10];
+        float *checkData[10];
+
+        for (int c = 0; c < 10; c++)
+          checkData[c] = check + c;
+
+        EvaluateTrack(anim, animTrack, &frameTimes[f], 1, settings.scale,
+                      checkData);
+
+        float dot = 0.f;
+
+        for (int c = 3; c < 7; c++)
+          dot += check[c] * frames[c][f];
+
+        // q and -q are same rotation
+        const float sign = dot < 0.f ? -1.f : 1.f;
+
+        for (int c = 0; c < 10 && !evaluate; c++) {
+          const float value = frames[c][f] * (c > 2 && c < 7 ? sign : 1.f);
+          evaluate = !NearlyEqual(check[c], value);
+        }
+
+        if (evaluate) {
+          linearTracks = false;
+          break;
+        }
+      }
+    }
+
+    if (evaluate)
+      EvaluateTrack(anim, animTrack, frameTimes.data(), numFrames,
+                    settings.scale, frames);
+
+    if (settings.reduceKeys) {
+      const float *positionFrames[] = {
+          track.position[0].data(), track.position[1].data(),
+          track.position[2].data()};
+      const float *scaleFrames[] = {track.scale[0].data(),
+                                    track.scale[1].data(),
+                                    track.scale[2].data()};
+
+      XenoReduceLinear(positionFrames, 3, numFrames,
+                       settings.positionTolerance, track.keys[0]);
+      XenoReduceRotation(rotationFrames, numFrames,
+                         settings.rotationTolerance * (3.1415926f / 180.f),
+                         track.keys[1]);
+      XenoReduceLinear(scaleFrames, 3, numFrames, settings.scaleTolerance,
+                       track.keys[2]);
+    } else {
+      for (auto &k : track.keys) {
+        k.resize(numFrames);
+
+        for (int f = 0; f < numFrames; f++)
+          k[f] = f;
+      }
+    }
+  });
+
+  return retval;
+}
+
+static long long GetModifiedTime(const TSTRING &path) {
+#ifdef _MSC_VER
+  struct _stat64 info;
+
+  if (_tstat64(path.c_str(), &info))
+    return -1;
+#else
+  struct stat info;
+
+  if (stat(path.c_str(), &info))
+    return -1;
+#endif
+
+  return static_cast<long long>(info.st_mtime);
+}
+
+static void RemoveFile(const TSTRING &path) {
+#ifdef _MSC_VER
+  _tremove(path.c_str());
+#else
+  remove(path.c_str());
+#endif
+}
+
+void XenoTextureQueue::Push(XenoExtractedTexture texture) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished.push_back(std::move(texture));
+  }
+
+  textureAdded.notify_one();
+}
+
+void XenoTextureQueue::Pop(std::vector<XenoExtractedTexture> &out,
+                           bool wait) {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (wait)
+    textureAdded.wait(lock, [&] { return !finished.empty(); });
+
+  std::move(finished.begin(), finished.end(), std::back_inserter(out));
+  finished.clear();
+}
+
+// Decoding and encoding of single texture is split over pool as well, so
+// large textures left at the end of extraction don't run on one thread.
+// Returns written file, XenoLib leaves .dds, when it can't convert texture.
+static TSTRING ExtractTexture(const MXMDTextures::Ptr &textures,
+                              const TSTRING &folder, const TSTRING &outPath,
+                              int textureID,
+                              const TextureConversionParams &params,
+                              XenoPNGProfile profile, XenoThreadPool *pool) {
+  const TSTRING ddsPath = outPath + _T(".dds");
+  const TSTRING pngPath = outPath + _T(".png");
+
+  // Only reading and writing .dds is serialized, conversion runs in parallel
+  TextureConversionParams ddsParams = params;
+  ddsParams.uncompress = false;
+  int result;
+
+  {
+    std::lock_guard<std::mutex> lock(XenoStreamMutex());
+    result = textures->ExtractTexture(folder.c_str(), textureID, ddsParams);
+  }
+
+  if (result)
+    return TSTRING();
+
+  if (!params.uncompress)
+    return ddsPath;
+
+  const bool converted = XenoConvertDDSToPNG(
+      ddsPath, pngPath, params.allowBC5ZChan, profile, pool);
+  RemoveFile(ddsPath);
+
+  if (converted)
+    return pngPath;
+
+  // Formats other than BC1-BC5 are converted by XenoLib within same call,
+  // so their whole conversion is serialized.
+  // Leftover .png of earlier run would pass for converted texture.
+  RemoveFile(pngPath);
+  std::lock_guard<std::mutex> lock(XenoStreamMutex());
+
+  if (textures->ExtractTexture(folder.c_str(), textureID, params))
+    return TSTRING();
+
+  return GetModifiedTime(pngPath) < 0 ? ddsPath : pngPath;
+}
+
+void XenoExtractTextures(MXMDTextures::Ptr textures, const TSTRING &folder,
+                         const TextureConversionParams &params,
+                         XenoPNGProfile profile, XenoThreadPool &pool,
+                         XenoTextureQueue *queue, XenoTextureCache *cache,
+                         const TSTRING &sourcePath) {
+  const int numTextures = textures->GetNumTextures();
+  XenoThreadPool *texPool = &pool;
+
+  for (int t = 0; t < numTextures; t++)
+    pool.Push([textures, folder, params, profile, t, queue, cache,
+               sourcePath, texPool] {
+      const TSTRING outPath =
+          folder + esStringConvert<TCHAR>(textures->GetTextureName(t));
+      TSTRING writtenPath;
+
+      if (cache) {
+        const uint64_t key = XenoTextureCache::MakeKey(
+            cache->SourceHash(sourcePath), t, params, profile);
+
+        if (!cache->Fetch(key, outPath, writtenPath)) {
+          writtenPath = ExtractTexture(textures, folder, outPath, t, params,
+                                       profile, texPool);
+
+          if (writtenPath.size())
+            cache->Store(key, writtenPath);
+        }
+      } else
+        writtenPath = ExtractTexture(textures, folder, outPath, t, params,
+                                     profile, texPool);
+
+      // Failed texture still points to where XenoLib would write it
+      if (writtenPath.empty())
+        writtenPath = outPath + _T(".dds");
+
+      if (queue)
+        queue->Push({t, writtenPath});
+    });
+}
+
+namespace {
+struct MotionCatalogEntry {
+  long long modifiedTime;
+  std::shared_ptr<const XenoMotionCatalog> catalog;
+};
+
+std::mutex motionCatalogsMutex;
+std::map<TSTRING, MotionCatalogEntry> motionCatalogs;
+} // namespace
+
+std::shared_ptr<const XenoMotionCatalog>
+XenoFindMotionCatalog(const TSTRING &path) {
+  const long long modifiedTime = GetModifiedTime(path);
+  std::lock_guard<std::mutex> lock(motionCatalogsMutex);
+  auto found = motionCatalogs.find(path);
+
+  if (modifiedTime < 0 || found == motionCatalogs.end() ||
+      found->second.modifiedTime != modifiedTime)
+    return nullptr;
+
+  return found->second.catalog;
+}
+
+// XenoLib exposes BC header fields only after Link, which relocates every
+// pointer of the file. Tracks aren't decoded until sampled.
+std::shared_ptr<const XenoMotionCatalog>
+XenoScanMotionCatalog(const TSTRING &path, SAR &archive) {
+  auto catalog = std::make_shared<XenoMotionCatalog>();
+
+  for (int f = 0; f < archive.NumFiles(); f++) {
+    AFileInfo fleInfo(archive.GetFileName(f));
+
+    if (fleInfo.GetExtension().compare(".anm"))
+      continue;
+
+    BC anmFile;
+
+    if (anmFile.Link(archive.GetFile(f)))
+      continue;
+
+    BCANIM *anm = anmFile.GetClass<BCANIM>();
+
+    if (!anm)
+      continue;
+
+    XenoMotionInfo info;
+    info.name = fleInfo.GetFileName().c_str();
+    info.fileID = f;
+    info.frameCount = anm->frameCount;
+    info.boneCount = anm->animData->boneCount;
+    catalog->push_back(std::move(info));
+  }
+
+  const long long modifiedTime = GetModifiedTime(path);
+
+  if (modifiedTime >= 0) {
+    std::lock_guard<std::mutex> lock(motionCatalogsMutex);
+    motionCatalogs[path] = {modifiedTime, catalog};
+  }
+
+  return catalog;
+}
@@ -0,0 +1,302 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Scene-neutral intermediate representation.
+// Everything in here decodes XenoLib data without touching any host
+// application, so it can be shared between the 3ds max plugin and
+// the headless command line tool.
+
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BC.h"
+#include "MXMD.h"
+#include "SAR.h"
+#include "XenoPNG.h"
+
+class XenoThreadPool;
+class XenoTextureCache;
+
+// Budget counts triangles only, vertex and buffer cost is not considered.
+enum XenoLODPolicy {
+  XenoLOD_All,    // every LOD level
+  XenoLOD_Base,   // finest LOD level only
+  XenoLOD_Budget, // finest LOD level, that fits into LODBudget triangles
+};
+
+struct XenoSettings {
+  float scale = 1.f;
+  int numThreads = 0;        // 0: one per hardware thread
+  int numTextureThreads = 0; // 0: one per hardware thread
+  XenoLODPolicy LODPolicy = XenoLOD_All;
+  int LODBudget = 0; // triangles per mesh group
+  bool reduceKeys = false;
+  float positionTolerance = 0.f; // scaled units
+  float rotationTolerance = 0.f; // degrees
+  float scaleTolerance = 0.f;
+};
+
+// Converts Xenoblade space (Y up) into Z up space, same as corMat.
+inline Vector XenoCorrectAxis(const Vector &in) {
+  return Vector(in.X, -in.Z, in.Y);
+}
+
+struct XenoMatrix {
+  Vector r[4];
+};
+
+struct XenoMapChannel {
+  int mapID;
+  std::vector<Vector> verts;
+};
+
+struct XenoVertexWeight {
+  int boneids[4];
+  float weights[4];
+};
+
+struct XenoMorphTarget {
+  std::string name;
+  std::vector<int> indices;
+  std::vector<Vector> deltas;
+};
+
+// Decoded vertex and face buffer pair, compacted to referenced vertices.
+// Shared by every mesh object, that uses same buffers.
+struct XenoMeshBuffers {
+  std::vector<Vector> positions;
+  std::vector<Vector> normals;
+  std::vector<XenoMapChannel> maps;
+  std::vector<USVector> faces;
+  std::vector<ushort> weightIDs;
+  int numWeightEntries; // highest weight id + 1
+  std::vector<XenoMorphTarget> morphs;
+  bool hasMorphs;
+};
+
+// Decoded weight palette of skin descriptor, one array per influence slot.
+struct XenoWeightPalette {
+  std::vector<int> boneids[4];
+  std::vector<float> weights[4];
+
+  int Size() const { return static_cast<int>(boneids[0].size()); }
+};
+
+// Compact skin of mesh object. Every vertex points to deduplicated influence
+// set, sets have zero weights dropped and bones indexed into usedBones.
+struct XenoSkin {
+  std::vector<int> usedBones;  // referenced skin bones, ascending
+  std::vector<int> setOffsets; // begin of every set, plus end
+  std::vector<int> setBones;
+  std::vector<float> setWeights;
+  std::vector<int> vertexSets;
+
+  int NumSets() const { return static_cast<int>(setOffsets.size()) - 1; }
+};
+
+struct XenoMesh {
+  std::string name;
+  int group;
+  int LOD;
+  int materialID;
+  std::shared_ptr<const XenoMeshBuffers> buffers;
+  XenoSkin skin;
+};
+
+// Per import cache of decoded buffers, keyed by group, vertex buffer and face
+// buffer, and weight palettes, keyed by group and skin descriptor.
+// Only valid for single model and same settings.
+struct XenoMeshCache {
+  struct Key {
+    int group;
+    int bufferID;
+    int facesID;
+
+    bool operator<(const Key &o) const {
+      if (group != o.group)
+        return group < o.group;
+      if (bufferID != o.bufferID)
+        return bufferID < o.bufferID;
+      return facesID < o.facesID;
+    }
+  };
+
+  typedef std::pair<int, int> PaletteKey;
+
+  std::map<Key, std::shared_ptr<const XenoMeshBuffers>> entries;
+  std::map<PaletteKey, std::shared_ptr<const XenoWeightPalette>> palettes;
+  size_t hits = 0;
+  size_t misses = 0;
+  size_t paletteHits = 0;
+  size_t paletteMisses = 0;
+
+  void Clear() {
+    entries.clear();
+    palettes.clear();
+    hits = 0;
+    misses = 0;
+    paletteHits = 0;
+    paletteMisses = 0;
+  }
+};
+
+struct XenoBone {
+  std::string name;
+  int parentID;
+  Vector4 rotation;
+  Vector position;
+  Vector scale;
+};
+
+// Bone from MXMD model, transform is absolute and inverted (bind matrix).
+struct XenoPoseBone {
+  std::string name;
+  std::string parentName;
+  XenoMatrix bindTM;
+};
+
+struct XenoTransform {
+  Vector4 rotation;
+  Vector position;
+  Vector scale;
+};
+
+// Baked track, every component array has one value per frame.
+// Frames to key are stored per channel: position, rotation and scale.
+struct XenoAnimTrack {
+  int boneID;
+  std::vector<float> position[3];
+  std::vector<float> rotation[4];
+  std::vector<float> scale[3];
+  std::vector<int> keys[3];
+
+  XenoTransform GetFrame(int frame) const;
+};
+
+struct XenoAnimation {
+  std::vector<float> frameTimes;
+  std::vector<XenoAnimTrack> tracks;
+};
+
+struct XenoMotionInfo {
+  std::string name;
+  int fileID; // file index in archive
+  int frameCount;
+  int boneCount;
+};
+
+typedef std::vector<XenoMotionInfo> XenoMotionCatalog;
+
+struct XenoInstance {
+  XenoMatrix transform;
+  std::vector<int> groups;
+};
+
+// XenoLib reads and decompresses .wismt and .casmt streams lazily, without
+// any synchronization. Every call that can touch them (MXMD::GetGeometry,
+// MXMDTextures::ExtractTexture) is made under this lock, decoding already
+// loaded buffers is not.
+std::mutex &XenoStreamMutex();
+
+// Picks LOD level of mesh group by settings policy, -1 means all levels.
+// Mesh objects with LOD 0 don't belong to any level and are always used.
+int XenoSelectLOD(MXMD *model, MXMDModel::Ptr &mdl, int curGroup,
+                  const XenoSettings &settings);
+
+// Decodes mesh objects of all groups in parallel, one vector per group.
+// Only LOD levels selected by XenoSelectLOD are decoded.
+// Buffers missing in cache are decoded once and stored there.
+std::vector<std::vector<XenoMesh>>
+XenoDecodeMeshGroups(MXMD *model, MXMDModel::Ptr &mdl,
+                     const std::vector<int> &groups,
+                     const XenoSettings &settings, XenoThreadPool &pool,
+                     XenoMeshCache &cache);
+
+// Decodes single LOD level of mesh group, skipped by XenoDecodeMeshGroups.
+// Model must be still loaded, shared buffers are taken from cache.
+std::vector<XenoMesh> XenoDecodeMeshLOD(MXMD *model, MXMDModel::Ptr &mdl,
+                                        int curGroup, int LOD,
+                                        const XenoSettings &settings,
+                                        XenoThreadPool &pool,
+                                        XenoMeshCache &cache);
+std::vector<XenoPoseBone> XenoDecodeModelPose(MXMDModel::Ptr &model,
+                                              const XenoSettings &settings);
+std::vector<XenoBone> XenoDecodeSkeleton(BCSKEL *skel,
+                                         const XenoSettings &settings);
+std::vector<XenoInstance> XenoDecodeInstances(MXMD *model,
+                                              const XenoSettings &settings);
+
+// Frame grid in seconds, rounded to whole frames, same way host does it.
+std::vector<float> XenoFrameGrid(BCANIM *anim, float frameRate);
+// Bakes every track over frameTimes, tracks are baked in parallel.
+// Every frame is keyed, unless settings.reduceKeys is set.
+XenoAnimation XenoBakeAnimation(BCANIM *anim,
+                                const std::vector<float> &frameTimes,
+                                const XenoSettings &settings,
+                                XenoThreadPool &pool);
+
+// File written by texture extraction job, expected .dds path when extraction
+// failed.
+struct XenoExtractedTexture {
+  int textureID;
+  TSTRING path;
+};
+
+// Extraction jobs publish finished textures here, consumer picks them up,
+// while other jobs still run.
+class XenoTextureQueue {
+public:
+  void Push(XenoExtractedTexture texture);
+  // Moves finished textures into out, with wait blocks until there is one.
+  void Pop(std::vector<XenoExtractedTexture> &out, bool wait);
+
+private:
+  std::vector<XenoExtractedTexture> finished;
+  std::mutex mutex;
+  std::condition_variable textureAdded;
+};
+
+// Queues every texture as separate extraction job, each one decompresses,
+// converts and writes its own file. pool.Wait() finishes extraction.
+// Decompression holds XenoStreamMutex. BC1-BC5 textures are converted by
+// XenoConvertDDSToPNG outside of it with either profile, rest of them falls
+// back to XenoLib, which converts under the lock.
+// Every job pushes its written file into queue, if any.
+// With cache, textures of same source model file are copied from it instead,
+// source is hashed by first job, not by calling thread.
+void XenoExtractTextures(MXMDTextures::Ptr textures, const TSTRING &folder,
+                         const TextureConversionParams &params,
+                         XenoPNGProfile profile, XenoThreadPool &pool,
+                         XenoTextureQueue *queue,
+                         XenoTextureCache *cache = nullptr,
+                         const TSTRING &sourcePath = TSTRING());
+
+// Cached motion catalog of .mot archive, nullptr when archive was never
+// scanned or was modified since.
+std::shared_ptr<const XenoMotionCatalog>
+XenoFindMotionCatalog(const TSTRING &path);
+// Lists .anm clips of archive loaded from path. Every clip is linked once
+// to read its counts, so cold scan costs as much as linking whole archive.
+// Result is cached per path and modification time, repeated scans are free.
+std::shared_ptr<const XenoMotionCatalog>
+XenoScanMotionCatalog(const TSTRING &path, SAR &archive);
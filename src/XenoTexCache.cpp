@@ -0,0 +1,503 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "XenoTexCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#include <sys/locking.h>
+#else
+#include <dirent.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include "datas/fileinfo.hpp"
+
+static const uint64_t fnvPrime = 0x100000001b3ULL;
+static const long long orphanAge = 3600; // seconds
+
+uint64_t XenoHashBytes(const void *data, size_t size, uint64_t seed) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+
+  for (size_t b = 0; b < size; b++)
+    seed = (seed ^ bytes[b]) * fnvPrime;
+
+  return seed;
+}
+
+static bool HashFile(const TSTRING &path, uint64_t &hash) {
+  std::ifstream stream(path.c_str(), std::ios::binary);
+
+  if (!stream)
+    return false;
+
+  char buffer[0x10000];
+
+  while (stream) {
+    stream.read(buffer, sizeof(buffer));
+    hash = XenoHashBytes(buffer, static_cast<size_t>(stream.gcount()), hash);
+  }
+
+  return true;
+}
+
+static bool GetFileInfo(const TSTRING &path, uint64_t &size,
+                        long long &modified) {
+#ifdef _MSC_VER
+  struct _stat64 info;
+
+  if (_tstat64(path.c_str(), &info))
+    return false;
+#else
+  struct stat info;
+
+  if (stat(path.c_str(), &info))
+    return false;
+#endif
+
+  size = static_cast<uint64_t>(info.st_size);
+  modified = static_cast<long long>(info.st_mtime);
+
+  return true;
+}
+
+static uint64_t Now() { return static_cast<uint64_t>(time(nullptr)); }
+
+static bool CopyFileData(const TSTRING &from, const TSTRING &to,
+                         uint64_t &size) {
+  std::ifstream inStream(from.c_str(), std::ios::binary);
+
+  if (!inStream)
+    return false;
+
+  std::ofstream outStream(to.c_str(), std::ios::binary);
+
+  if (!outStream)
+    return false;
+
+  outStream << inStream.rdbuf();
+  size = static_cast<uint64_t>(outStream.tellp());
+
+  return static_cast<bool>(outStream);
+}
+
+static void RemoveFile(const TSTRING &path) {
+#ifdef _MSC_VER
+  _tremove(path.c_str());
+#else
+  remove(path.c_str());
+#endif
+}
+
+static bool RenameFile(const TSTRING &from, const TSTRING &to) {
+#ifdef _MSC_VER
+  return !_trename(from.c_str(), to.c_str());
+#else
+  return !rename(from.c_str(), to.c_str());
+#endif
+}
+
+namespace {
+// Exclusive lock of cache folder index, shared with other processes.
+// Without lock file (read only folder), cache works unlocked.
+class FolderLock {
+public:
+  explicit FolderLock(const TSTRING &path) {
+#ifdef _MSC_VER
+    handle = _topen(path.c_str(), _O_RDWR | _O_CREAT, _S_IREAD | _S_IWRITE);
+
+    // _LK_LOCK gives up after 10 seconds
+    if (handle >= 0)
+      while (_locking(handle, _LK_LOCK, 1)) {
+      }
+#else
+    handle = open(path.c_str(), O_RDWR | O_CREAT, 0666);
+
+    if (handle >= 0)
+      flock(handle, LOCK_EX);
+#endif
+  }
+
+  ~FolderLock() {
+    if (handle < 0)
+      return;
+
+#ifdef _MSC_VER
+    _locking(handle, _LK_UNLCK, 1);
+    _close(handle);
+#else
+    close(handle); // releases flock
+#endif
+  }
+
+private:
+  int handle;
+};
+} // namespace
+
+XenoTextureCache::XenoTextureCache(const TSTRING &folder, uint64_t maxSize)
+    : folder(folder), maxSize(maxSize) {
+  if (this->folder.size() && this->folder.back() != '/' &&
+      this->folder.back() != '\\')
+    this->folder.push_back('/');
+
+#ifdef _MSC_VER
+  _tmkdir(this->folder.c_str());
+#else
+  mkdir(this->folder.c_str(), 0777);
+#endif
+
+  FolderLock folderLock(this->folder + _T("lock"));
+  LoadIndex(entries, sources);
+
+  for (auto &e : entries)
+    totalSize += e.second.size;
+}
+
+XenoTextureCache::~XenoTextureCache() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::lock_guard<std::mutex> sourceLock(sourceMutex);
+  SaveIndex();
+}
+
+uint64_t XenoTextureCache::MakeKey(uint64_t sourceHash, int textureID,
+                                   const TextureConversionParams &params,
+                                   XenoPNGProfile profile) {
+  const int values[] = {textureID, params.allowBC5ZChan, params.uncompress,
+                        profile};
+
+  return XenoHashBytes(values, sizeof(values), sourceHash);
+}
+
+TSTRING XenoTextureCache::EntryPath(uint64_t key, bool png) const {
+  char name[24];
+  const int nameSize =
+      snprintf(name, sizeof(name), "%016llx.%s",
+               static_cast<unsigned long long>(key), png ? "png" : "dds");
+
+  return folder + TSTRING(name, name + nameSize);
+}
+
+// Called under sourceMutex.
+uint64_t XenoTextureCache::FileHash(const TSTRING &path) {
+  uint64_t size;
+  long long modified;
+
+  if (!GetFileInfo(path, size, modified))
+    return 0;
+
+  const uint64_t pathHash =
+      XenoHashBytes(path.data(), path.size() * sizeof(TCHAR));
+  auto found = sources.find(pathHash);
+
+  if (found != sources.end() && found->second.size == size &&
+      found->second.modified == modified)
+    return found->second.hash;
+
+  uint64_t hash = XenoHashBytes(nullptr, 0);
+  HashFile(path, hash);
+  sources[pathHash] = {size, modified, hash};
+
+  return hash;
+}
+
+// Textures of .wimdo and .camdo are streamed from .wismt and .casmt
+uint64_t XenoTextureCache::SourceHash(const TSTRING &modelPath) {
+  TFileInfo fleInfo(modelPath);
+  TSTRING extension = fleInfo.GetExtension();
+  TSTRING streamPath = fleInfo.GetPath() + fleInfo.GetFileName();
+
+  if (!extension.compare(_T(".wimdo")))
+    streamPath.append(_T(".wismt"));
+  else if (!extension.compare(_T(".camdo")))
+    streamPath.append(_T(".casmt"));
+  else
+    streamPath.clear();
+
+  // Held while hashing, concurrent callers wait instead of reading again
+  std::lock_guard<std::mutex> lock(sourceMutex);
+  const uint64_t fileHashes[] = {
+      FileHash(modelPath), streamPath.size() ? FileHash(streamPath) : 0};
+
+  return XenoHashBytes(fileHashes, sizeof(fileHashes));
+}
+
+bool XenoTextureCache::Fetch(uint64_t key, const TSTRING &outPath,
+                             TSTRING &writtenPath) {
+  bool png;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(key);
+
+    if (found == entries.end()) {
+      misses++;
+      return false;
+    }
+
+    found->second.lastUse = Now();
+    png = found->second.png;
+  }
+
+  uint64_t size;
+  writtenPath = outPath + (png ? _T(".png") : _T(".dds"));
+
+  if (!CopyFileData(EntryPath(key, png), writtenPath, size)) {
+    // Cache file went missing, forget it and extract again
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = entries.find(key);
+
+    if (found != entries.end()) {
+      totalSize -= found->second.size;
+      entries.erase(found);
+    }
+
+    misses++;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  hits++;
+
+  return true;
+}
+
+// Copied into temporary file first, so neither this nor other process sees
+// partially written entry.
+void XenoTextureCache::Store(uint64_t key, const TSTRING &path) {
+  if (path.size() < 4)
+    return;
+
+  const bool png = !path.compare(path.size() - 4, 4, _T(".png"));
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (entries.count(key))
+      return;
+  }
+
+#ifdef _MSC_VER
+  const int processID = _getpid();
+#else
+  const int processID = getpid();
+#endif
+
+  char suffix[16];
+  const int suffixSize = snprintf(suffix, sizeof(suffix), ".%x.tmp",
+                                  static_cast<unsigned>(processID));
+  const TSTRING entryPath = EntryPath(key, png);
+  const TSTRING tempPath = entryPath + TSTRING(suffix, suffix + suffixSize);
+  uint64_t size;
+
+  if (!CopyFileData(path, tempPath, size)) {
+    RemoveFile(tempPath);
+    return;
+  }
+
+  // Other process could have stored same entry meanwhile
+  if (!RenameFile(tempPath, entryPath)) {
+    RemoveFile(tempPath);
+
+    uint64_t storedSize;
+    long long modified;
+
+    if (!GetFileInfo(entryPath, storedSize, modified) || storedSize != size)
+      return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (entries.count(key))
+    return;
+
+  entries[key] = {png, size, Now()};
+  totalSize += size;
+  Evict();
+}
+
+void XenoTextureCache::LoadIndex(EntryMap &outEntries,
+                                 SourceMap &outSources) const {
+  std::ifstream index((folder + _T("index")).c_str());
+  unsigned long long key, size, lastUse;
+  int png;
+
+  while (index >> std::hex >> key >> std::dec >> png >> size >> lastUse)
+    outEntries[key] = {png != 0, size, lastUse};
+
+  std::ifstream sourceIndex((folder + _T("sources")).c_str());
+  unsigned long long pathHash, hash;
+  long long modified;
+
+  while (sourceIndex >> std::hex >> pathHash >> hash >> std::dec >> size >>
+         modified)
+    outSources[pathHash] = {size, modified, hash};
+}
+
+void XenoTextureCache::Evict() {
+  if (totalSize <= maxSize)
+    return;
+
+  std::vector<std::pair<uint64_t, uint64_t>> usage; // lastUse, key
+  usage.reserve(entries.size());
+
+  for (auto &e : entries)
+    usage.emplace_back(e.second.lastUse, e.first);
+
+  std::sort(usage.begin(), usage.end());
+
+  for (auto &u : usage) {
+    if (totalSize <= maxSize)
+      break;
+
+    const Entry &entry = entries[u.second];
+    RemoveFile(EntryPath(u.second, entry.png));
+    totalSize -= entry.size;
+    entries.erase(u.second);
+  }
+}
+
+// Other processes could have added or evicted entries since index was
+// loaded. Their entries are merged into ours, entries without file were
+// evicted by someone and are dropped.
+void XenoTextureCache::SaveIndex() {
+  FolderLock folderLock(folder + _T("lock"));
+  EntryMap storedEntries;
+  SourceMap storedSources;
+  LoadIndex(storedEntries, storedSources);
+
+  for (auto &e : storedEntries) {
+    auto found = entries.find(e.first);
+
+    if (found == entries.end())
+      entries.insert(e);
+    else
+      found->second.lastUse =
+          std::max(found->second.lastUse, e.second.lastUse);
+  }
+
+  totalSize = 0;
+
+  for (auto it = entries.begin(); it != entries.end();) {
+    uint64_t size;
+    long long modified;
+
+    if (!GetFileInfo(EntryPath(it->first, it->second.png), size, modified))
+      it = entries.erase(it);
+    else {
+      totalSize += it->second.size;
+      it++;
+    }
+  }
+
+  Evict();
+
+  // Ours are newer
+  for (auto &s : storedSources)
+    sources.insert(s);
+
+  std::ofstream index((folder + _T("index")).c_str());
+
+  for (auto &e : entries)
+    index << std::hex << e.first << std::dec << ' ' << e.second.png << ' '
+          << e.second.size << ' ' << e.second.lastUse << '\n';
+
+  std::ofstream sourceIndex((folder + _T("sources")).c_str());
+
+  for (auto &s : sources)
+    sourceIndex << std::hex << s.first << ' ' << s.second.hash << std::dec
+                << ' ' << s.second.size << ' ' << s.second.modified << '\n';
+
+  RemoveOrphans();
+}
+
+// Entry files missing from index and stale temporary files are left by
+// crashed or racing processes. Recent ones could still be in flight.
+void XenoTextureCache::RemoveOrphans() const {
+  std::vector<TSTRING> names;
+
+#ifdef _MSC_VER
+  _tfinddata64_t findData;
+  const intptr_t handle =
+      _tfindfirst64((folder + _T("*.*")).c_str(), &findData);
+
+  if (handle != -1) {
+    do
+      names.push_back(findData.name);
+    while (!_tfindnext64(handle, &findData));
+
+    _findclose(handle);
+  }
+#else
+  DIR *dir = opendir(folder.c_str());
+
+  if (dir) {
+    while (dirent *item = readdir(dir))
+      names.push_back(item->d_name);
+
+    closedir(dir);
+  }
+#endif
+
+  const long long threshold = static_cast<long long>(Now()) - orphanAge;
+
+  for (auto &n : names) {
+    const size_t extension = n.find('.');
+
+    if (extension != 16)
+      continue;
+
+    const TSTRING keyName = n.substr(0, 16);
+
+    if (keyName.find_first_not_of(_T("0123456789abcdef")) != keyName.npos)
+      continue;
+
+    const TSTRING suffix = n.substr(16);
+    const bool isEntry = suffix == _T(".png") || suffix == _T(".dds");
+
+    if (isEntry) {
+      uint64_t key = 0;
+
+      for (auto c : keyName)
+        key = key << 4 | (c <= '9' ? c - '0' : c - 'a' + 10);
+
+      auto found = entries.find(key);
+
+      if (found != entries.end() && found->second.png == (suffix[1] == 'p'))
+        continue;
+    } else if (suffix.size() < 4 ||
+               suffix.compare(suffix.size() - 4, 4, _T(".tmp")))
+      continue;
+
+    const TSTRING path = folder + n;
+    uint64_t size;
+    long long modified;
+
+    if (GetFileInfo(path, size, modified) && modified < threshold)
+      RemoveFile(path);
+  }
+}
@@ -0,0 +1,92 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Content addressed on disk cache of extracted textures.
+
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "MXMD.h"
+#include "XenoPNG.h"
+
+// FNV-1a over buffer, seed chains several buffers.
+uint64_t XenoHashBytes(const void *data, size_t size,
+                       uint64_t seed = 0xcbf29ce484222325ULL);
+
+// Extracted textures keyed by source hash and conversion params.
+// Least recently used files are evicted, whenever maxSize bytes is exceeded.
+// Index is shared by processes through lock file, it's merged with other
+// processes' entries when cache is destroyed. Files no index knows about
+// are removed after an hour.
+class XenoTextureCache {
+public:
+  XenoTextureCache(const TSTRING &folder, uint64_t maxSize);
+  ~XenoTextureCache();
+
+  XenoTextureCache(const XenoTextureCache &) = delete;
+  XenoTextureCache &operator=(const XenoTextureCache &) = delete;
+
+  static uint64_t MakeKey(uint64_t sourceHash, int textureID,
+                          const TextureConversionParams &params,
+                          XenoPNGProfile profile);
+
+  // Hash of model file and its texture stream file, if present.
+  // Files are read only when their size or modification time changed since
+  // they were hashed last time.
+  uint64_t SourceHash(const TSTRING &modelPath);
+  // Copies cached texture to outPath with its extension, false on miss.
+  // writtenPath receives full path of copy.
+  bool Fetch(uint64_t key, const TSTRING &outPath, TSTRING &writtenPath);
+  // Stores extracted .png or .dds file, empty path is ignored.
+  void Store(uint64_t key, const TSTRING &path);
+
+  size_t hits = 0;
+  size_t misses = 0;
+
+private:
+  struct Entry {
+    bool png;
+    uint64_t size;
+    uint64_t lastUse; // seconds since epoch
+  };
+
+  struct Source {
+    uint64_t size;
+    long long modified;
+    uint64_t hash;
+  };
+
+  typedef std::unordered_map<uint64_t, Entry> EntryMap;
+  typedef std::unordered_map<uint64_t, Source> SourceMap; // by path hash
+
+  TSTRING folder;
+  uint64_t maxSize;
+  uint64_t totalSize = 0;
+  EntryMap entries;
+  SourceMap sources;
+  std::mutex mutex;
+  std::mutex sourceMutex;
+
+  TSTRING EntryPath(uint64_t key, bool png) const;
+  uint64_t FileHash(const TSTRING &path);
+  void LoadIndex(EntryMap &outEntries, SourceMap &outSources) const;
+  void Evict();
+  void SaveIndex();
+  void RemoveOrphans() const;
+};
@@ -0,0 +1,83 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "XenoThreads.h"
+
+XenoThreadPool::XenoThreadPool(int numThreads) {
+  if (numThreads < 1)
+    numThreads = std::thread::hardware_concurrency();
+
+  if (numThreads < 1)
+    numThreads = 1;
+
+  for (int t = 0; t < numThreads; t++)
+    workers.emplace_back(&XenoThreadPool::Worker, this);
+}
+
+XenoThreadPool::~XenoThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+
+  jobAdded.notify_all();
+
+  for (auto &w : workers)
+    w.join();
+}
+
+void XenoThreadPool::Push(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(std::move(job));
+  }
+
+  jobAdded.notify_one();
+}
+
+void XenoThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  jobsDone.wait(lock, [this] { return jobs.empty() && !numActive; });
+}
+
+void XenoThreadPool::Worker() {
+  for (;;) {
+    Job job;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      jobAdded.wait(lock, [this] { return stop || !jobs.empty(); });
+
+      if (stop && jobs.empty())
+        return;
+
+      job = std::move(jobs.front());
+      jobs.pop_front();
+      numActive++;
+    }
+
+    job();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      numActive--;
+
+      if (jobs.empty() && !numActive)
+        jobsDone.notify_all();
+    }
+  }
+}
@@ -0,0 +1,97 @@
+/*      Xenoblade Tool for 3ds Max
+        Copyright(C) 2017-2019 Lukas Cone
+
+        This program is free software : you can redistribute it and / or modify
+        it under the terms of the GNU General Public License as published by
+        the Free Software Foundation, either version 3 of the License, or
+        (at your option) any later version.
+
+        This program is distributed in the hope that it will be useful,
+        but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+        GNU General Public License for more details.
+
+        You should have received a copy of the GNU General Public License
+        along with this program.If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class XenoThreadPool {
+public:
+  typedef std::function<void()> Job;
+
+  // 0 threads means one per hardware thread
+  explicit XenoThreadPool(int numThreads = 0);
+  ~XenoThreadPool();
+
+  XenoThreadPool(const XenoThreadPool &) = delete;
+  XenoThreadPool &operator=(const XenoThreadPool &) = delete;
+
+  void Push(Job job);
+  // Blocks until every pushed job is done.
+  void Wait();
+  int NumThreads() const { return static_cast<int>(workers.size()); }
+
+private:
+  std::vector<std::thread> workers;
+  std::deque<Job> jobs;
+  std::mutex mutex;
+  std::condition_variable jobAdded;
+  std::condition_variable jobsDone;
+  int numActive = 0;
+  bool stop = false;
+
+  void Worker();
+};
+
+// Calls func(index) for every index in [0, count) on pool and waits.
+// Calling thread takes indices as well and waits only for indices of this
+// call, so jobs of pool can use it over same pool. Helpers, that start after
+// every index is taken, leave without touching func.
+template <class F>
+void XenoParallelFor(XenoThreadPool &pool, int count, const F &func) {
+  struct State {
+    std::atomic<int> next{0};
+    std::atomic<int> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    const F *func;
+    int count;
+
+    void Run() {
+      for (int i; (i = next++) < count;) {
+        (*func)(i);
+
+        if (++done == count) {
+          std::lock_guard<std::mutex> lock(mutex);
+          finished.notify_all();
+        }
+      }
+    }
+  };
+
+  if (count < 1)
+    return;
+
+  std::shared_ptr<State> state = std::make_shared<State>();
+  state->func = &func;
+  state->count = count;
+  const int numHelpers =
+      count - 1 < pool.NumThreads() ? count - 1 : pool.NumThreads();
+
+  for (int h = 0; h < numHelpers; h++)
+    pool.Push([state] { state->Run(); });
+
+  state->Run();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock, [&] { return state->done == count; });
+}
@@ -13,8 +13,25 @@
 #define IDC_BT_ABOUT                    1009
 #define IDC_CB_MOTIONINDEX              1034
 #define IDC_CH_GLOBAL_FRAMES            1035
+#define IDC_CB_LODPOLICY                1036
+#define IDC_CH_REDUCEKEYS               1037
+#define IDC_CH_ALLMOTIONS               1038
+#define IDC_CH_FASTPNG                  1039
+#define IDC_EDIT_MOTIONSET              1040
 #define IDC_EDIT_SCALE                  1490
 #define IDC_SPIN_SCALE                  1496
+#define IDC_EDIT_LODBUDGET              1497
+#define IDC_SPIN_LODBUDGET              1498
+#define IDC_EDIT_POSTOLERANCE           1499
+#define IDC_SPIN_POSTOLERANCE           1500
+#define IDC_EDIT_ROTTOLERANCE           1501
+#define IDC_SPIN_ROTTOLERANCE           1502
+#define IDC_EDIT_SCLTOLERANCE           1503
+#define IDC_SPIN_SCLTOLERANCE           1504
+#define IDC_EDIT_TEXTHREADS             1505
+#define IDC_SPIN_TEXTHREADS             1506
+#define IDC_EDIT_TEXCACHE               1507
+#define IDC_SPIN_TEXCACHE               1508
 
 // Next default values for new objects
 // 
@@ -22,7 +39,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        113
 #define _APS_NEXT_COMMAND_VALUE         40001
-#define _APS_NEXT_CONTROL_VALUE         1036
+#define _APS_NEXT_CONTROL_VALUE         1041
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif